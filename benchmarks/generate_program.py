@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+
+# Generates a synthetic Delta program for measuring how compile time scales along one axis.
+#
+# Usage: generate_program.py <axis> <size> <output-directory>
+#
+# Prints the paths of the generated Delta source files, relative to the output directory. The generated C headers
+# are placed in the output directory as well, which should be passed to the compiler with -I.
+
+import os
+import sys
+
+axes = ["files", "functions", "instantiations", "structs", "c-headers", "nesting"]
+
+# The number of functions in each file of the 'files' axis, and in each header of the 'c-headers' axis.
+functions_per_file = 20
+
+
+def generate_files(size):
+    files = {}
+    for i in range(size):
+        lines = []
+        for j in range(functions_per_file):
+            callee = "f{}_{}(x)".format(i, j - 1) if j > 0 else ("f{}_{}(x)".format(i - 1, functions_per_file - 1) if i > 0 else "x")
+            lines.append("int f{}_{}(int x) {{\n    return {} + {};\n}}\n".format(i, j, callee, j))
+        files["file{}.delta".format(i)] = "\n".join(lines)
+    files["main.delta"] = "int main() {{\n    return f{}_{}(0) - f{}_{}(0);\n}}\n".format(
+        size - 1, functions_per_file - 1, size - 1, functions_per_file - 1)
+    return files
+
+
+def generate_functions(size):
+    lines = ["int f0(int x) {\n    return x;\n}\n"]
+    for i in range(1, size):
+        lines.append("int f{}(int x) {{\n    var y = f{}(x) + {};\n    if (y > {}) {{\n        return y - 1;\n    }}\n    return y;\n}}\n"
+                     .format(i, i - 1, i % 7, i * 3))
+    lines.append("int main() {{\n    return f{}(0) - f{}(0);\n}}\n".format(size - 1, size - 1))
+    return {"main.delta": "\n".join(lines)}
+
+
+def generate_instantiations(size):
+    lines = [
+        "struct Wrapper<T>: Copyable {\n    T value;\n\n    Wrapper(T value) {\n        this.value = value;\n    }\n\n"
+        "    T get() {\n        return value;\n    }\n}\n",
+        "T identity<T>(T value) {\n    return Wrapper(value).get();\n}\n",
+    ]
+    for i in range(size):
+        lines.append("struct Type{}: Copyable {{\n    int value;\n\n    Type{}(int value) {{\n"
+                     "        this.value = value;\n    }}\n}}\n".format(i, i))
+
+    body = ["    var list = List<int>();"]
+    for i in range(size):
+        body.append("    list.push(identity(Type{}({})).value);".format(i, i))
+        body.append("    var list{} = List<Type{}>();".format(i, i))
+        body.append("    list{}.push(Type{}({}));".format(i, i, i))
+    body.append("    return list.size() - {};".format(size))
+    lines.append("int main() {\n" + "\n".join(body) + "\n}\n")
+    return {"main.delta": "\n".join(lines)}
+
+
+def generate_structs(size):
+    lines = []
+    for i in range(size):
+        field_type = "S{}".format(i - 1) if i > 0 else "int"
+        inner = "inner.sum()" if i > 0 else "inner"
+        lines.append("struct S{}: Copyable {{\n    {} inner;\n    int value;\n\n    S{}({} inner, int value) {{\n"
+                     "        this.inner = inner;\n        this.value = value;\n    }}\n\n    int sum() {{\n"
+                     "        return {} + value;\n    }}\n}}\n".format(i, field_type, i, field_type, inner))
+
+    # Construct the nested struct in steps, so that the nesting of the constructor calls doesn't grow with size.
+    body = ["    var s0 = S0(0, 0);"]
+    for i in range(1, size):
+        body.append("    var s{} = S{}(s{}, {});".format(i, i, i - 1, i))
+    body.append("    return s{}.sum() - {};".format(size - 1, sum(range(size))))
+    lines.append("int main() {\n" + "\n".join(body) + "\n}\n")
+    return {"main.delta": "\n".join(lines)}
+
+
+def generate_c_headers(size):
+    files = {}
+    imports = []
+    body = ["    var sum = 0;"]
+    for i in range(size):
+        header = ["#pragma once", "", "struct header{}_struct {{".format(i), "    int a;", "    double b;", "};", ""]
+        for j in range(functions_per_file):
+            header.append("int header{}_function{}(int x, struct header{}_struct* s);".format(i, j, i))
+        header.append("#define HEADER{}_CONSTANT {}".format(i, i))
+        files["header{}.h".format(i)] = "\n".join(header) + "\n"
+        imports.append('import "header{}.h";'.format(i))
+        body.append("    sum += HEADER{}_CONSTANT;".format(i))
+    body.append("    return sum - {};".format(sum(range(size))))
+    files["main.delta"] = "\n".join(imports) + "\n\nint main() {\n" + "\n".join(body) + "\n}\n"
+    return files
+
+
+def generate_nesting(size):
+    body = ["    var x = 0;"]
+    for i in range(size):
+        indent = "    " * (2 * i + 1)
+        body.append("{}for (var i{} in 0..2) {{".format(indent, i))
+        body.append("{}    if (i{} == 0) {{".format(indent, i))
+    body.append("    " * (2 * size + 1) + "x = (x + 1) * 1;")
+    for i in reversed(range(size)):
+        indent = "    " * (2 * i + 1)
+        body.append("{}    }}".format(indent))
+        body.append("{}}}".format(indent))
+
+    expression = "x"
+    for i in range(size):
+        expression = "({} + {})".format(expression, i)
+    body.append("    return {} - {} - 1;".format(expression, sum(range(size))))
+    return {"main.delta": "int main() {\n" + "\n".join(body) + "\n}\n"}
+
+
+generators = {
+    "files": generate_files,
+    "functions": generate_functions,
+    "instantiations": generate_instantiations,
+    "structs": generate_structs,
+    "c-headers": generate_c_headers,
+    "nesting": generate_nesting,
+}
+
+
+def generate(axis, size, output_directory):
+    """Writes the program to the output directory and returns the paths of its Delta source files."""
+    if not os.path.exists(output_directory):
+        os.makedirs(output_directory)
+
+    source_files = []
+    for name, content in sorted(generators[axis](size).items()):
+        with open(os.path.join(output_directory, name), "w") as file:
+            file.write(content)
+        if name.endswith(".delta"):
+            source_files.append(name)
+    return source_files
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 4 or sys.argv[1] not in axes:
+        sys.exit("usage: generate_program.py <" + "|".join(axes) + "> <size> <output-directory>")
+
+    for source_file in generate(sys.argv[1], int(sys.argv[2]), sys.argv[3]):
+        print(source_file)
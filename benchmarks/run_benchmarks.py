@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+
+# Runs the benchmarks in this directory with 'delta bench' and writes the combined results as JSON, in the format
+# accepted by 'delta bench -baseline', so that runtime performance can be tracked across compiler versions.
+#
+# Usage: run_benchmarks.py <delta-path> <output-json-path> [extra 'delta bench' flags...]
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# Benchmark files and the additional source files they're compiled with.
+benchmarks = [
+    ("containers.delta", []),
+    ("strings.delta", []),
+    ("brainfuck.delta", ["../examples/brainfuck.delta"]),
+]
+
+delta_path = os.path.abspath(sys.argv[1]) if len(sys.argv) > 1 else "delta"
+output_path = os.path.abspath(sys.argv[2]) if len(sys.argv) > 2 else "benchmark-results.json"
+extra_flags = sys.argv[3:]
+
+os.chdir(os.path.dirname(os.path.abspath(__file__)))
+
+results = []
+failed = False
+
+for file, extra_sources in benchmarks:
+    fd, results_path = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+
+    # The output of the benchmarks themselves (e.g. println and the brainfuck programs) goes to stdout as well,
+    # so it's captured and only the relevant lines are shown.
+    command = [delta_path, "bench", file] + extra_sources + ["-save=" + results_path] + extra_flags
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    output = process.communicate()[0]
+
+    if process.returncode != 0:
+        failed = True
+        lines = [line for line in output.splitlines() if "regression" in line or "regressed" in line or "error:" in line]
+        print("\n".join(lines) if lines else output)
+
+    if os.path.getsize(results_path) > 0:
+        with open(results_path) as results_file:
+            results += json.load(results_file)["benchmarks"]
+    os.remove(results_path)
+
+for result in results:
+    print("{:<32} {:>14.2f} ns/op {:>10.2f} allocs/op".format(result["name"], result["ns-per-op"], result["allocs-per-op"]))
+
+with open(output_path, "w") as output_file:
+    json.dump({"benchmarks": results}, output_file, indent=2)
+    output_file.write("\n")
+
+print("Benchmark results written to " + output_path)
+
+if failed:
+    sys.exit(1)
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+
+# Compiles programs generated by generate_program.py at increasing sizes along each axis, and writes the wall time
+# and peak memory of each compiler phase (from -print-stats=json) as JSON, so that compile time scaling can be
+# tracked across compiler versions. The scaling exponent printed for each axis is the slope of total wall time
+# versus program size on a log-log scale between the two largest sizes: 1 means linear, 2 quadratic.
+#
+# Usage: run_compile_time_benchmarks.py <delta-path> <output-json-path> [axis...]
+
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import generate_program
+
+sizes = {
+    "files": [25, 50, 100, 200],
+    "functions": [1000, 2000, 4000, 8000],
+    "instantiations": [100, 200, 400, 800],
+    "structs": [100, 200, 400, 800],
+    "c-headers": [25, 50, 100, 200],
+    "nesting": [25, 50, 100, 200],
+}
+
+delta_path = os.path.abspath(sys.argv[1]) if len(sys.argv) > 1 else "delta"
+output_path = os.path.abspath(sys.argv[2]) if len(sys.argv) > 2 else "compile-time-results.json"
+axes = sys.argv[3:] or generate_program.axes
+
+results = []
+failed = False
+
+for axis in axes:
+    times = []
+
+    for size in sizes[axis]:
+        directory = tempfile.mkdtemp(prefix="delta-compile-time-")
+        try:
+            source_files = generate_program.generate(axis, size, directory)
+            command = [delta_path, "-c", "-print-stats=json", "-I" + directory] + source_files
+            start = time.time()
+            process = subprocess.Popen(command, cwd=directory, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                       universal_newlines=True)
+            output, statistics = process.communicate()
+            wall_time = time.time() - start
+        finally:
+            shutil.rmtree(directory)
+
+        if process.returncode != 0:
+            print("{} {}: compilation failed:\n{}{}".format(axis, size, output, statistics))
+            failed = True
+            break
+
+        statistics = json.loads(statistics)
+        results.append({
+            "axis": axis,
+            "size": size,
+            "wall-time-us": int(wall_time * 1e6),
+            "peak-rss-bytes": statistics["process"]["peak-rss-bytes"],
+            "phases": {
+                phase: {
+                    "wall-time-us": statistics["phases.wall-time-us"][phase],
+                    "rss-growth-bytes": statistics["phases.rss-growth-bytes"][phase],
+                } for phase in statistics["phases.wall-time-us"]
+            },
+        })
+        times.append((size, wall_time))
+
+        phases = " ".join("{}={:.0f}ms".format(phase, values["wall-time-us"] / 1000.0)
+                          for phase, values in sorted(results[-1]["phases"].items()))
+        print("{:<16} {:>6} {:>10.0f}ms {:>8.1f}MB  {}".format(axis, size, wall_time * 1000, results[-1]["peak-rss-bytes"] / 1e6, phases))
+
+    if len(times) >= 2 and times[-2][1] > 0:
+        (size1, time1), (size2, time2) = times[-2:]
+        print("{:<16} scaling exponent {:.2f}".format(axis, math.log(time2 / time1) / math.log(float(size2) / size1)))
+
+with open(output_path, "w") as output_file:
+    json.dump({"compile-time-benchmarks": results}, output_file, indent=2)
+    output_file.write("\n")
+
+print("Compile time benchmark results written to " + output_path)
+
+if failed:
+    sys.exit(1)
@@ -0,0 +1,20 @@
+#include "compilation-context.h"
+
+using namespace delta;
+
+static thread_local CompilationContext* currentCompilationContext = nullptr;
+
+CompilationContext& CompilationContext::getCurrent() {
+    if (currentCompilationContext) return *currentCompilationContext;
+    // Never destroyed, because the leaked modules may still refer to it when the process exits.
+    static auto* defaultCompilationContext = new CompilationContext();
+    return *defaultCompilationContext;
+}
+
+CompilationContextScope::CompilationContextScope(CompilationContext& context) : previousContext(currentCompilationContext) {
+    currentCompilationContext = &context;
+}
+
+CompilationContextScope::~CompilationContextScope() {
+    currentCompilationContext = previousContext;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#pragma warning(push, 0)
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#pragma warning(pop)
+#include "identifier.h"
+
+namespace delta {
+
+class FunctionDecl;
+class Module;
+class SourceFile;
+class TypeBase;
+
+/// The state of a compilation that outlives the individual parsers and typecheckers: the identifier and type tables,
+/// the imported modules, and the source file buffers. Compilations in different contexts share nothing, so they can
+/// run concurrently, e.g. the frontends of the targets built by 'delta build'. A thread uses the process-wide default
+/// context unless a CompilationContextScope is alive on it.
+class CompilationContext {
+public:
+    CompilationContext() = default;
+    CompilationContext(const CompilationContext&) = delete;
+    CompilationContext& operator=(const CompilationContext&) = delete;
+    /// Returns the context of the compilation running on the current thread.
+    static CompilationContext& getCurrent();
+
+    /// The interned identifiers. See Identifier.
+    llvm::StringMap<char, llvm::BumpPtrAllocator> identifierTable;
+    /// The interned types, keyed by their structural hash. Types are allocated from typeAllocator and never freed.
+    std::unordered_multimap<size_t, TypeBase*> typeBases;
+    llvm::BumpPtrAllocator typeAllocator;
+    /// The imported Delta modules and C headers, by name.
+    llvm::StringMap<Module*> importedModules;
+    /// The modules that declare each name at global scope. See Module::getModulesDeclaring().
+    llvm::DenseMap<Identifier, llvm::SmallVector<Module*, 1>> declarationIndex;
+    /// Functions in imported modules whose bodies haven't been typechecked yet because they haven't been referenced,
+    /// mapped to the source file they're declared in. This outlives the Typechecker because the compile server reuses
+    /// typechecked modules across compilations.
+    llvm::DenseMap<FunctionDecl*, SourceFile*> uncheckedFunctionBodies;
+    /// The contents of the source files read by the lexer, kept alive because source locations point into them.
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> fileBuffers;
+    /// The number of lambdas created so far, used to give each one a unique name.
+    uint64_t lambdaCount = 0;
+};
+
+/// Makes the given context the current one on the current thread until destroyed.
+class CompilationContextScope {
+public:
+    explicit CompilationContextScope(CompilationContext& context);
+    ~CompilationContextScope();
+
+private:
+    CompilationContext* previousContext;
+};
+
+} // namespace delta
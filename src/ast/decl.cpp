@@ -2,11 +2,24 @@
 #pragma warning(push, 0)
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
+#include "module.h"
+#include "../support/stats.h"
 #include "../support/utility.h"
 
 using namespace delta;
 
+// Must be in the same order as the DeclKind enumerators.
+static const char* const declKindNames[] = {
+    "GenericParamDecl", "FunctionDecl", "MethodDecl", "ConstructorDecl", "DestructorDecl", "FunctionTemplate", "TypeDecl",
+    "TypeTemplate", "EnumDecl", "EnumCase", "VarDecl", "FieldDecl", "ParamDecl", "ImportDecl",
+};
+
+Decl::Decl(DeclKind kind, AccessLevel accessLevel) : kind(kind), accessLevel(accessLevel), referenced(false) {
+    if (collectStatistics) addStatistic("ast.decls", declKindNames[static_cast<int>(kind)]);
+}
+
 FunctionProto FunctionProto::instantiate(const llvm::StringMap<Type>& genericArgs) const {
     auto params = instantiateParams(getParams(), genericArgs);
     auto returnType = getReturnType().resolve(genericArgs);
@@ -18,9 +31,14 @@ FunctionDecl* FunctionTemplate::instantiate(const llvm::StringMap<Type>& generic
     ASSERT(!genericParams.empty() && !genericArgs.empty());
 
     auto orderedGenericArgs = map(genericParams, [&](auto& genericParam) { return genericArgs.find(genericParam.getName())->second; });
+    addStatistic("instantiations", "function-template-requests");
 
     auto it = instantiations.find(orderedGenericArgs);
     if (it != instantiations.end()) return it->second;
+
+    checkCanModifySharedState();
+    addStatistic("instantiations", "function-template-instantiations");
+    llvm::TimeTraceScope timeScope("Instantiate function", [&] { return getQualifiedName(); });
     auto instantiation = getFunctionDecl()->instantiate(genericArgs, orderedGenericArgs);
     return instantiations.emplace(std::move(orderedGenericArgs), instantiation).first->second;
 }
@@ -72,6 +90,15 @@ FunctionDecl* FunctionDecl::instantiate(const llvm::StringMap<Type>& genericArgs
     return instantiation;
 }
 
+bool FunctionDecl::isInstantiation() const {
+    return !getGenericArgs().empty() || (getTypeDecl() && !getTypeDecl()->getGenericArgs().empty());
+}
+
+/// Instantiations are always generated from source because the set of instantiations depends on the code using them.
+bool FunctionDecl::hasPrecompiledBody() const {
+    return module.isPrecompiled() && !isInstantiation();
+}
+
 bool FunctionTemplate::isReferenced() const {
     if (Decl::isReferenced()) {
         return true;
@@ -185,6 +212,17 @@ Type TypeDecl::getTypeForPassing() const {
     }
 }
 
+TypeDecl* TypeDecl::instantiateInterface(Type thisType) const {
+    ASSERT(isInterface());
+    std::vector<Type> key = {thisType};
+    auto it = interfaceInstantiations.find(key);
+    if (it != interfaceInstantiations.end()) return it->second;
+
+    checkCanModifySharedState();
+    auto* instantiation = llvm::cast<TypeDecl>(instantiate({{"This", thisType}}, {}));
+    return interfaceInstantiations.emplace(std::move(key), instantiation).first->second;
+}
+
 unsigned TypeDecl::getFieldIndex(const FieldDecl* field) const {
     for (auto& p : llvm::enumerate(fields)) {
         if (&p.value() == field) {
@@ -197,14 +235,23 @@ unsigned TypeDecl::getFieldIndex(const FieldDecl* field) const {
 TypeDecl* TypeTemplate::instantiate(const llvm::StringMap<Type>& genericArgs) {
     ASSERT(!genericParams.empty() && !genericArgs.empty());
     auto orderedGenericArgs = map(genericParams, [&](auto& genericParam) { return genericArgs.find(genericParam.getName())->second; });
+    addStatistic("instantiations", "type-template-requests");
 
     auto it = instantiations.find(orderedGenericArgs);
     if (it != instantiations.end()) return it->second;
 
+    checkCanModifySharedState();
+    addStatistic("instantiations", "type-template-instantiations");
+    llvm::TimeTraceScope timeScope("Instantiate type", [&] { return getQualifiedTypeName(getName(), orderedGenericArgs); });
     auto instantiation = llvm::cast<TypeDecl>(getTypeDecl()->instantiate(genericArgs, orderedGenericArgs));
     return instantiations.emplace(std::move(orderedGenericArgs), instantiation).first->second;
 }
 
+TypeDecl* TypeTemplate::getInstantiation(llvm::ArrayRef<Type> genericArgs) const {
+    auto it = instantiations.find(genericArgs.vec());
+    return it != instantiations.end() ? it->second : nullptr;
+}
+
 TypeDecl* TypeTemplate::instantiate(llvm::ArrayRef<Type> genericArgs) {
     ASSERT(genericArgs.size() == genericParams.size());
     llvm::StringMap<Type> genericArgsMap;
@@ -253,7 +300,9 @@ bool Decl::hasBeenMoved() const {
     }
 }
 
-// TODO: Ensure that the same decl isn't instantiated multiple times with same generic args, to avoid duplicate work.
+/// Creates a new copy of the decl with the given generic arguments substituted. Callers are responsible for reusing
+/// existing instantiations, see FunctionTemplate::instantiate, TypeTemplate::instantiate, and
+/// TypeDecl::instantiateInterface.
 Decl* Decl::instantiate(const llvm::StringMap<Type>& genericArgs, llvm::ArrayRef<Type> genericArgsArray) const {
     switch (getKind()) {
         case DeclKind::ParamDecl:
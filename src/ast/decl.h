@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <vector>
 #pragma warning(push, 0)
+#include <llvm/ADT/Hashing.h>
 #include <llvm/ADT/Optional.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/Support/Casting.h>
@@ -17,12 +18,14 @@
 namespace std {
 template<>
 struct hash<std::vector<delta::Type>> {
+    /// Consistent with operator== for Type, which compares the types structurally, so that e.g. List<int> is only
+    /// instantiated once even if its generic argument is represented by different TypeBase objects.
     size_t operator()(llvm::ArrayRef<delta::Type> types) const {
         ASSERT(!types.empty());
-        size_t hashValue = reinterpret_cast<size_t>(types[0].getBase());
+        llvm::hash_code hashValue = llvm::hash_value(types.size());
 
-        for (auto type : types.drop_front()) {
-            hashValue ^= reinterpret_cast<size_t>(type.getBase());
+        for (auto type : types) {
+            hashValue = llvm::hash_combine(hashValue, type.getBase()->getStructuralHash(), type.isMutable());
         }
 
         return hashValue;
@@ -112,7 +115,7 @@ public:
     Decl* instantiate(const llvm::StringMap<Type>& genericArgs, llvm::ArrayRef<Type> genericArgsArray) const;
 
 protected:
-    Decl(DeclKind kind, AccessLevel accessLevel) : kind(kind), accessLevel(accessLevel), referenced(false) {}
+    Decl(DeclKind kind, AccessLevel accessLevel);
 
 private:
     DeclKind kind;
@@ -238,6 +241,8 @@ public:
     FunctionDecl* instantiate(const llvm::StringMap<Type>& genericArgs, llvm::ArrayRef<Type> genericArgsArray);
     bool isTypechecked() const { return typechecked; }
     void setTypechecked(bool typechecked) { this->typechecked = typechecked; }
+    bool isInstantiation() const;
+    bool hasPrecompiledBody() const;
     static bool classof(const Decl* d) { return d->isFunctionDecl(); }
 
 protected:
@@ -337,6 +342,8 @@ public:
     unsigned getFieldIndex(const FieldDecl* field) const;
     Module* getModule() const override { return &module; }
     const TypeDecl* getInstantiatedFrom() const { return instantiatedFrom; }
+    /// Returns this interface with 'This' replaced by the given type. Each instantiation is only created once.
+    TypeDecl* instantiateInterface(Type thisType) const;
     static bool classof(const Decl* d) { return d->isTypeDecl(); }
 
 protected:
@@ -354,6 +361,7 @@ private:
     SourceLocation location;
     Module& module;
     const TypeDecl* instantiatedFrom;
+    mutable std::unordered_map<std::vector<Type>, TypeDecl*> interfaceInstantiations;
 };
 
 class TypeTemplate : public Decl {
@@ -365,6 +373,8 @@ public:
     TypeDecl* getTypeDecl() const { return typeDecl; }
     TypeDecl* instantiate(const llvm::StringMap<Type>& genericArgs);
     TypeDecl* instantiate(llvm::ArrayRef<Type> genericArgs);
+    /// Returns the existing instantiation with the given generic arguments, or null if there's none yet.
+    TypeDecl* getInstantiation(llvm::ArrayRef<Type> genericArgs) const;
     Module* getModule() const override { return typeDecl->getModule(); }
     SourceLocation getLocation() const override { return typeDecl->getLocation(); }
     static bool classof(const Decl* d) { return d->getKind() == DeclKind::TypeTemplate; }
@@ -2,11 +2,24 @@
 #pragma warning(push, 0)
 #include <llvm/Support/ErrorHandling.h>
 #pragma warning(pop)
+#include "compilation-context.h"
 #include "decl.h"
 #include "token.h"
+#include "../support/stats.h"
 
 using namespace delta;
 
+// Must be in the same order as the ExprKind enumerators.
+static const char* const exprKindNames[] = {
+    "VarExpr", "StringLiteralExpr", "CharacterLiteralExpr", "IntLiteralExpr", "FloatLiteralExpr", "BoolLiteralExpr",
+    "NullLiteralExpr", "UndefinedLiteralExpr", "ArrayLiteralExpr", "TupleExpr", "UnaryExpr", "BinaryExpr", "CallExpr",
+    "SizeofExpr", "AddressofExpr", "MemberExpr", "IndexExpr", "UnwrapExpr", "LambdaExpr", "IfExpr", "ImplicitCastExpr",
+};
+
+Expr::Expr(ExprKind kind, SourceLocation location) : kind(kind), location(location) {
+    if (collectStatistics) addStatistic("ast.exprs", exprKindNames[static_cast<int>(kind)]);
+}
+
 bool Expr::isAssignment() const {
     auto* binaryExpr = llvm::dyn_cast<BinaryExpr>(this);
     return binaryExpr && isAssignmentOperator(binaryExpr->getOperator());
@@ -483,8 +496,8 @@ llvm::APSInt BinaryExpr::getConstantIntegerValue() const {
 
 LambdaExpr::LambdaExpr(std::vector<ParamDecl>&& params, Expr* body, Module* module, SourceLocation location)
 : Expr(ExprKind::LambdaExpr, location) {
-    static uint64_t nameCounter = 0;
-    FunctionProto proto("__lambda" + std::to_string(nameCounter++), std::move(params), Type(), false, false);
+    auto lambdaIndex = CompilationContext::getCurrent().lambdaCount++;
+    FunctionProto proto("__lambda" + std::to_string(lambdaIndex), std::move(params), Type(), false, false);
     this->functionDecl = new FunctionDecl(std::move(proto), std::vector<Type>(), AccessLevel::Private, *module, getLocation());
     std::vector<Stmt*> stmts;
     stmts.push_back(new ReturnStmt(body, body->getLocation()));
@@ -89,7 +89,7 @@ public:
     bool isThis() const;
 
 protected:
-    Expr(ExprKind kind, SourceLocation location) : kind(kind), location(location) {}
+    Expr(ExprKind kind, SourceLocation location);
 
 private:
     ExprKind kind;
@@ -0,0 +1,23 @@
+#include "identifier.h"
+#include "compilation-context.h"
+#include "../support/stats.h"
+#include "../support/utility.h"
+
+using namespace delta;
+
+Identifier Identifier::get(llvm::StringRef name) {
+    // Looked up first, so that threads that may only read the identifier table can still get existing identifiers.
+    if (auto identifier = find(name)) return identifier;
+
+    checkCanModifySharedState();
+    auto result = CompilationContext::getCurrent().identifierTable.try_emplace(name);
+    if (result.second) addStatistic("identifiers", "interned");
+    return Identifier(&*result.first);
+}
+
+Identifier Identifier::find(llvm::StringRef name) {
+    auto& identifierTable = CompilationContext::getCurrent().identifierTable;
+    auto it = identifierTable.find(name);
+    if (it == identifierTable.end()) return Identifier();
+    return Identifier(&*it);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <llvm/ADT/DenseMapInfo.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#pragma warning(pop)
+
+namespace delta {
+
+/// A name interned into the identifier table of the current CompilationContext. Identifiers with the same spelling
+/// share the same table entry, so that they can be compared and hashed by pointer instead of by their characters.
+class Identifier {
+public:
+    Identifier() : entry(nullptr) {}
+    /// Returns the identifier with the given spelling, adding it to the identifier table if it's not there yet.
+    static Identifier get(llvm::StringRef name);
+    /// Returns the identifier with the given spelling, or the null identifier if no such identifier has been interned.
+    static Identifier find(llvm::StringRef name);
+    llvm::StringRef str() const { return entry ? entry->getKey() : llvm::StringRef(); }
+    operator llvm::StringRef() const { return str(); }
+    explicit operator bool() const { return entry != nullptr; }
+    bool operator==(Identifier other) const { return entry == other.entry; }
+    bool operator!=(Identifier other) const { return entry != other.entry; }
+    const void* getAsOpaquePointer() const { return entry; }
+    static Identifier getFromOpaquePointer(const void* pointer) { return Identifier(static_cast<const Entry*>(pointer)); }
+
+private:
+    using Entry = llvm::StringMapEntry<char>;
+    explicit Identifier(const Entry* entry) : entry(entry) {}
+
+    const Entry* entry;
+};
+
+} // namespace delta
+
+namespace llvm {
+template<>
+struct DenseMapInfo<delta::Identifier> {
+    static delta::Identifier getEmptyKey() {
+        return delta::Identifier::getFromOpaquePointer(DenseMapInfo<const void*>::getEmptyKey());
+    }
+    static delta::Identifier getTombstoneKey() {
+        return delta::Identifier::getFromOpaquePointer(DenseMapInfo<const void*>::getTombstoneKey());
+    }
+    static unsigned getHashValue(delta::Identifier identifier) {
+        return DenseMapInfo<const void*>::getHashValue(identifier.getAsOpaquePointer());
+    }
+    static bool isEqual(delta::Identifier a, delta::Identifier b) { return a == b; }
+};
+} // namespace llvm
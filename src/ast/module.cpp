@@ -2,18 +2,41 @@
 
 using namespace delta;
 
-llvm::StringMap<Module*> Module::allImportedModules;
+thread_local std::vector<Scope*> SymbolTable::localScopes;
+
+Module::~Module() {
+    for (auto name : indexedNames) {
+        auto it = context.declarationIndex.find(name);
+        llvm::erase_if(it->second, [&](Module* module) { return module == this; });
+        if (it->second.empty()) context.declarationIndex.erase(it);
+    }
+}
 
 std::vector<Module*> Module::getAllImportedModules() {
-    return map(allImportedModules, [](auto& p) { return p.second; });
+    return map(getAllImportedModulesMap(), [](auto& p) { return p.second; });
 }
 
 Module* Module::getStdlibModule() {
-    auto it = allImportedModules.find("std");
-    if (it == allImportedModules.end()) return nullptr;
+    auto& importedModules = getAllImportedModulesMap();
+    auto it = importedModules.find("std");
+    if (it == importedModules.end()) return nullptr;
     return it->second;
 }
 
+llvm::ArrayRef<Module*> Module::getModulesDeclaring(Identifier name) {
+    auto& declarationIndex = CompilationContext::getCurrent().declarationIndex;
+    auto it = declarationIndex.find(name);
+    if (it == declarationIndex.end()) return {};
+    return it->second;
+}
+
+void Module::addToDeclarationIndex(Identifier name) {
+    auto& modules = context.declarationIndex[name];
+    if (llvm::is_contained(modules, this)) return;
+    modules.push_back(this);
+    indexedNames.push_back(name);
+}
+
 void Module::addToSymbolTableWithName(Decl& decl, llvm::StringRef name) {
     if (auto existing = getSymbolTable().findInCurrentScope(name); !existing.empty()) {
         REPORT_ERROR_WITH_NOTES(decl.getLocation(), getPreviousDefinitionNotes(existing), "redefinition of '" << name << "'");
@@ -80,10 +103,42 @@ void Module::addIdentifierReplacement(llvm::StringRef source, llvm::StringRef ta
     getSymbolTable().addIdentifierReplacement(source, target);
 }
 
+void SymbolTable::add(llvm::StringRef name, Decl* decl) {
+    auto identifier = Identifier::get(name);
+    auto& currentScope = getCurrentScope();
+    if (&currentScope == &globalScope) checkCanModifySharedState();
+    currentScope.decls[identifier].push_back(decl);
+    if (&currentScope == &globalScope) module->addToDeclarationIndex(identifier);
+}
+
+void SymbolTable::addGlobal(llvm::StringRef name, Decl* decl) {
+    auto identifier = Identifier::get(name);
+    checkCanModifySharedState();
+    globalScope.decls[identifier].push_back(decl);
+    module->addToDeclarationIndex(identifier);
+}
+
+void SymbolTable::addIdentifierReplacement(llvm::StringRef name, llvm::StringRef replacement) {
+    auto identifier = Identifier::get(name);
+    checkCanModifySharedState();
+    identifierReplacements.try_emplace(identifier, Identifier::get(replacement));
+    module->addToDeclarationIndex(identifier);
+}
+
+void SymbolTable::pushScope(Scope& scope) {
+    if (&scope != &globalScope) localScopes.push_back(&scope);
+}
+
+void SymbolTable::popScope(Scope& scope) {
+    if (&scope == &globalScope) return;
+    ASSERT(localScopes.back() == &scope);
+    localScopes.pop_back();
+}
+
 Scope::Scope(Decl* parent, SymbolTable* symbolTable) : parent(parent), symbolTable(symbolTable) {
     symbolTable->pushScope(*this);
 }
 
 Scope::~Scope() {
-    symbolTable->popScope();
+    symbolTable->popScope(*this);
 }
@@ -4,11 +4,14 @@
 #include <vector>
 #pragma warning(push, 0)
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
 #pragma warning(pop)
+#include "compilation-context.h"
 #include "decl.h"
+#include "identifier.h"
 
 namespace delta {
 
@@ -39,7 +42,7 @@ private:
 struct Scope {
     Decl* parent;
     SymbolTable* symbolTable;
-    llvm::StringMap<std::vector<Decl*>> decls;
+    llvm::DenseMap<Identifier, std::vector<Decl*>> decls;
 
     Scope(Decl* parent, SymbolTable* symbolTable);
     ~Scope();
@@ -47,20 +50,33 @@ struct Scope {
 
 class SymbolTable {
 public:
-    SymbolTable() : globalScope(nullptr, this) {}
-    Scope& getCurrentScope() { return *scopes.back(); }
-    void add(llvm::StringRef name, Decl* decl) { scopes.back()->decls[name].push_back(decl); }
-    void addGlobal(llvm::StringRef name, Decl* decl) { scopes.front()->decls[name].push_back(decl); }
-    void addIdentifierReplacement(llvm::StringRef name, llvm::StringRef replacement) {
-        identifierReplacements.try_emplace(name, replacement);
+    explicit SymbolTable(Module* module) : module(module), globalScope(nullptr, this) {}
+    Scope& getCurrentScope() { return const_cast<Scope&>(static_cast<const SymbolTable*>(this)->getCurrentScope()); }
+
+    const Scope& getCurrentScope() const {
+        for (auto* scope : llvm::reverse(localScopes)) {
+            if (scope->symbolTable == this) return *scope;
+        }
+        return globalScope;
     }
 
-    llvm::ArrayRef<Decl*> find(llvm::StringRef name) const {
+    void add(llvm::StringRef name, Decl* decl);
+    void addGlobal(llvm::StringRef name, Decl* decl);
+    void addIdentifierReplacement(llvm::StringRef name, llvm::StringRef replacement);
+
+    /// Names that have never been interned can't be in any symbol table, so looking them up doesn't intern them.
+    llvm::ArrayRef<Decl*> find(llvm::StringRef name) const { return find(Identifier::find(name)); }
+
+    llvm::ArrayRef<Decl*> find(Identifier name) const {
+        if (!name) return {};
         auto realName = applyIdentifierReplacements(name);
-        for (auto& scope : llvm::reverse(scopes)) {
+        for (auto* scope : llvm::reverse(localScopes)) {
+            if (scope->symbolTable != this) continue;
             auto it = scope->decls.find(realName);
             if (it != scope->decls.end()) return it->second;
         }
+        auto it = globalScope.decls.find(realName);
+        if (it != globalScope.decls.end()) return it->second;
         return {};
     }
 
@@ -72,9 +88,11 @@ public:
     }
 
     llvm::ArrayRef<Decl*> findInCurrentScope(llvm::StringRef name) const {
-        if (!scopes.empty()) {
-            auto it = scopes.back()->decls.find(applyIdentifierReplacements(name));
-            if (it != scopes.back()->decls.end()) return it->second;
+        auto identifier = Identifier::find(name);
+        if (identifier) {
+            auto& currentScope = getCurrentScope();
+            auto it = currentScope.decls.find(applyIdentifierReplacements(identifier));
+            if (it != currentScope.decls.end()) return it->second;
         }
         return {};
     }
@@ -93,8 +111,8 @@ public:
 
 private:
     friend struct Scope;
-    void pushScope(Scope& scope) { scopes.push_back(&scope); }
-    void popScope() { scopes.pop_back(); }
+    void pushScope(Scope& scope);
+    void popScope(Scope& scope);
 
     static bool paramsMatch(const ParamDecl& a, const ParamDecl& b) {
         if (a.getType() != b.getType()) return false;
@@ -102,8 +120,8 @@ private:
         return true;
     }
 
-    llvm::StringRef applyIdentifierReplacements(llvm::StringRef name) const {
-        llvm::StringRef initialName = name;
+    Identifier applyIdentifierReplacements(Identifier name) const {
+        Identifier initialName = name;
         while (true) {
             auto it = identifierReplacements.find(name);
             if (it == identifierReplacements.end()) return name;
@@ -112,20 +130,31 @@ private:
         }
     }
 
-    std::vector<Scope*> scopes;
+    Module* module;
+    /// The local scopes entered by the current thread, of all symbol tables, innermost last. These are per thread so
+    /// that function bodies of the same module can be typechecked concurrently.
+    static thread_local std::vector<Scope*> localScopes;
     Scope globalScope;
-    llvm::StringMap<std::string> identifierReplacements;
+    llvm::DenseMap<Identifier, Identifier> identifierReplacements;
 };
 
 /// Container for the AST of a whole module, comprised of one or more SourceFiles.
 class Module {
 public:
-    Module(llvm::StringRef name) : name(name) {}
+    Module(llvm::StringRef name) : name(name), symbolTable(this), context(CompilationContext::getCurrent()) {}
+    ~Module();
     void addSourceFile(SourceFile&& file) { sourceFiles.emplace_back(std::move(file)); }
     llvm::ArrayRef<SourceFile> getSourceFiles() const { return sourceFiles; }
     llvm::MutableArrayRef<SourceFile> getSourceFiles() { return sourceFiles; }
     llvm::StringRef getName() const { return name; }
     SymbolTable& getSymbolTable() { return symbolTable; }
+    /// Returns true if the code of this module's non-generic functions is loaded from a precompiled artifact,
+    /// instead of being type-checked and generated from source.
+    bool isPrecompiled() const { return precompiled; }
+    void setPrecompiled(bool precompiled) { this->precompiled = precompiled; }
+    /// Returns the paths of the header files that were read when importing this module from a C header.
+    llvm::ArrayRef<std::string> getHeaderFiles() const { return headerFiles; }
+    void addHeaderFile(llvm::StringRef path) { headerFiles.push_back(path.str()); }
 
     std::vector<Module*> getImportedModules() const {
         std::vector<Module*> importedModules;
@@ -146,18 +175,31 @@ public:
     void addToSymbolTable(Decl* decl);
     void addIdentifierReplacement(llvm::StringRef source, llvm::StringRef target);
 
+    /// These return the modules imported in the current CompilationContext.
     static std::vector<Module*> getAllImportedModules();
-    static llvm::StringMap<Module*>& getAllImportedModulesMap() { return allImportedModules; }
+    static llvm::StringMap<Module*>& getAllImportedModulesMap() { return CompilationContext::getCurrent().importedModules; }
     static Module* getStdlibModule();
+    /// Returns the modules that declare the given name at global scope or have an identifier replacement for it, in
+    /// the order they first did so. This index covers all modules loaded in the current CompilationContext and is
+    /// updated as declarations are added, so that a name lookup only has to search the symbol tables of the modules
+    /// that can contain the name.
+    static llvm::ArrayRef<Module*> getModulesDeclaring(Identifier name);
 
 private:
+    friend class SymbolTable;
     void addToSymbolTableWithName(Decl& decl, llvm::StringRef name);
+    void addToDeclarationIndex(Identifier name);
 
 private:
     std::string name;
     std::vector<SourceFile> sourceFiles;
     SymbolTable symbolTable;
-    static llvm::StringMap<Module*> allImportedModules;
+    bool precompiled = false;
+    std::vector<std::string> headerFiles;
+    /// The names for which this module is in the declaration index, so that it can be removed when destroyed.
+    std::vector<Identifier> indexedNames;
+    /// The context this module was created in, which holds its identifiers, types, and declaration index entries.
+    CompilationContext& context;
 };
 
 } // namespace delta
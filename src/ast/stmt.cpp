@@ -1,8 +1,19 @@
 #include "stmt.h"
 #include "decl.h"
+#include "../support/stats.h"
 
 using namespace delta;
 
+// Must be in the same order as the StmtKind enumerators.
+static const char* const stmtKindNames[] = {
+    "ReturnStmt", "VarStmt", "ExprStmt", "DeferStmt", "IfStmt", "SwitchStmt", "WhileStmt", "ForStmt", "ForEachStmt", "BreakStmt",
+    "ContinueStmt", "CompoundStmt",
+};
+
+Stmt::Stmt(StmtKind kind) : kind(kind) {
+    if (collectStatistics) addStatistic("ast.stmts", stmtKindNames[static_cast<int>(kind)]);
+}
+
 bool Stmt::isBreakable() const {
     switch (getKind()) {
         case StmtKind::WhileStmt:
@@ -48,7 +48,7 @@ public:
     Stmt* instantiate(const llvm::StringMap<Type>& genericArgs) const;
 
 protected:
-    Stmt(StmtKind kind) : kind(kind) {}
+    Stmt(StmtKind kind);
 
 private:
     const StmtKind kind;
@@ -1,17 +1,18 @@
 #include "type.h"
 #include <sstream>
 #pragma warning(push, 0)
+#include <llvm/ADT/Hashing.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringSwitch.h>
 #include <llvm/Support/ErrorHandling.h>
 #pragma warning(pop)
+#include "compilation-context.h"
 #include "decl.h"
+#include "../support/stats.h"
 #include "../support/utility.h"
 
 using namespace delta;
 
-static std::vector<TypeBase*> typeBases;
-
 #define DEFINE_BUILTIN_TYPE_GET_AND_IS(TYPE, NAME) \
     Type Type::get##TYPE(Mutability mutability, SourceLocation location) { \
         static BasicType type(#NAME, /*genericArgs*/ {}); \
@@ -122,19 +123,80 @@ Type Type::resolve(const llvm::StringMap<Type>& replacements) const {
     llvm_unreachable("all cases handled");
 }
 
+static llvm::hash_code hashChildType(Type type) {
+    if (!type) return llvm::hash_value(0);
+    return llvm::hash_combine(type.getBase()->getStructuralHash(), type.isMutable());
+}
+
+size_t TypeBase::getStructuralHash() const {
+    if (size_t hash = structuralHash.load(std::memory_order_relaxed)) return hash;
+
+    llvm::hash_code hash = llvm::hash_value(static_cast<int>(kind));
+
+    switch (kind) {
+        case TypeKind::BasicType: {
+            auto* basicType = llvm::cast<BasicType>(this);
+            hash = llvm::hash_combine(hash, basicType->getName());
+            for (Type genericArg : basicType->getGenericArgs()) {
+                hash = llvm::hash_combine(hash, hashChildType(genericArg));
+            }
+            break;
+        }
+        case TypeKind::ArrayType: {
+            auto* arrayType = llvm::cast<ArrayType>(this);
+            hash = llvm::hash_combine(hash, hashChildType(arrayType->getElementType()), arrayType->getSize());
+            break;
+        }
+        case TypeKind::TupleType:
+            for (auto& element : llvm::cast<TupleType>(this)->getElements()) {
+                hash = llvm::hash_combine(hash, llvm::StringRef(element.name), hashChildType(element.type));
+            }
+            break;
+        case TypeKind::FunctionType: {
+            auto* functionType = llvm::cast<FunctionType>(this);
+            hash = llvm::hash_combine(hash, hashChildType(functionType->getReturnType()));
+            for (Type paramType : functionType->getParamTypes()) {
+                hash = llvm::hash_combine(hash, hashChildType(paramType));
+            }
+            break;
+        }
+        case TypeKind::PointerType:
+            hash = llvm::hash_combine(hash, hashChildType(llvm::cast<PointerType>(this)->getPointeeType()));
+            break;
+        case TypeKind::UnresolvedType:
+            // Unresolved types are never equal to each other.
+            hash = llvm::hash_combine(hash, this);
+            break;
+    }
+
+    // Zero means that the hash hasn't been computed yet.
+    size_t nonZeroHash = size_t(hash) != 0 ? size_t(hash) : 1;
+    structuralHash.store(nonZeroHash, std::memory_order_relaxed);
+    return nonZeroHash;
+}
+
+/// Returns the interned type that is structurally equal to the given one, creating it if it doesn't exist yet.
+/// Only types with the same structural hash are compared, so this is O(1) in the number of existing types.
 template<typename T>
 static Type getType(T&& typeBase, Mutability mutability, SourceLocation location) {
     Type newType(&typeBase, mutability, location);
+    addStatistic("types", "lookups");
+    size_t hash = typeBase.getStructuralHash();
+    auto& context = CompilationContext::getCurrent();
+    auto candidates = context.typeBases.equal_range(hash);
 
-    for (auto& existingTypeBase : typeBases) {
-        Type existingType(&*existingTypeBase, mutability, location);
+    for (auto it = candidates.first; it != candidates.second; ++it) {
+        Type existingType(it->second, mutability, location);
         if (existingType.equalsIgnoreTopLevelMutable(newType)) {
             return existingType;
         }
     }
 
-    typeBases.push_back(new T(std::forward<T>(typeBase)));
-    return Type(&*typeBases.back(), mutability, location);
+    checkCanModifySharedState();
+    auto* internedTypeBase = new (context.typeAllocator.Allocate<T>()) T(std::forward<T>(typeBase));
+    context.typeBases.emplace(hash, internedTypeBase);
+    addStatistic("types", "interned");
+    return Type(internedTypeBase, mutability, location);
 }
 
 Type BasicType::get(llvm::StringRef name, llvm::ArrayRef<Type> genericArgs, Mutability mutability, SourceLocation location) {
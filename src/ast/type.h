@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -34,12 +35,18 @@ class TypeBase {
 public:
     virtual ~TypeBase() = 0;
     TypeKind getKind() const { return kind; }
+    /// Returns a hash of the structure of this type, such that types for which Type::equalsIgnoreTopLevelMutable
+    /// returns true have the same hash. Computed on first use and cached, since types are immutable.
+    size_t getStructuralHash() const;
 
 protected:
-    TypeBase(TypeKind kind) : kind(kind) {}
+    TypeBase(TypeKind kind) : kind(kind), structuralHash(0) {}
+    TypeBase(const TypeBase& other) : kind(other.kind), structuralHash(other.structuralHash.load(std::memory_order_relaxed)) {}
 
 private:
     const TypeKind kind;
+    /// Atomic because function bodies may be typechecked concurrently, computing the hash on multiple threads.
+    mutable std::atomic<size_t> structuralHash;
 };
 
 inline TypeBase::~TypeBase() {}
@@ -170,7 +177,10 @@ public:
     llvm::StringRef getName() const { return name; }
     std::string getQualifiedName() const { return getQualifiedTypeName(name, genericArgs); }
     TypeDecl* getDecl() const { return decl; }
-    void setDecl(TypeDecl* decl) { this->decl = NOTNULL(decl); }
+    void setDecl(TypeDecl* decl) {
+        checkCanModifySharedState();
+        this->decl = NOTNULL(decl);
+    }
     static Type get(llvm::StringRef name, llvm::ArrayRef<Type> genericArgs, Mutability mutability = Mutability::Mutable,
                     SourceLocation location = SourceLocation());
     static bool classof(const TypeBase* t) { return t->getKind() == TypeKind::BasicType; }
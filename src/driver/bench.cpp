@@ -0,0 +1,267 @@
+#include "bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#pragma warning(push, 0)
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/raw_ostream.h>
+#pragma warning(pop)
+#include "jit.h"
+#include "../ast/decl.h"
+#include "../ast/mangle.h"
+#include "../ast/module.h"
+#include "../support/utility.h"
+
+using namespace delta;
+
+namespace {
+
+/// The Bencher struct defined in std/Bencher.delta.
+struct Bencher {
+    int32_t iterations;
+};
+
+using BenchmarkFunctionPointer = void (*)(Bencher*);
+
+struct Measurement {
+    double seconds;
+    uint64_t allocations;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    int64_t iterations;
+    double nanosecondsPerOperation;
+    /// The standard deviation of the samples' ns/op, relative to the mean, in percent.
+    double variation;
+    double allocationsPerOperation;
+};
+
+} // namespace
+
+static const int32_t maxIterations = std::numeric_limits<int32_t>::max();
+
+// The benchmarks' calls to malloc, calloc, and realloc are redirected here, so that their allocations can be counted.
+static uint64_t allocationCount = 0;
+
+static void* countAllocation(size_t size) {
+    allocationCount++;
+    return std::malloc(size);
+}
+
+static void* countZeroedAllocation(size_t count, size_t size) {
+    allocationCount++;
+    return std::calloc(count, size);
+}
+
+static void* countReallocation(void* pointer, size_t size) {
+    allocationCount++;
+    return std::realloc(pointer, size);
+}
+
+static bool isBencherPointer(Type type) {
+    if (!type.isPointerType()) return false;
+    auto* typeDecl = type.getPointee().getDecl();
+    return typeDecl && typeDecl->getName() == "Bencher" && typeDecl->getModule()->getName() == "std";
+}
+
+std::vector<BenchmarkFunction> delta::findBenchmarkFunctions(const Module& module) {
+    std::vector<BenchmarkFunction> benchmarks;
+
+    for (auto& sourceFile : module.getSourceFiles()) {
+        for (auto* decl : sourceFile.getTopLevelDecls()) {
+            auto* functionDecl = llvm::dyn_cast<FunctionDecl>(decl);
+            if (!functionDecl || functionDecl->isExtern() || functionDecl->getParams().size() != 1) continue;
+            if (!functionDecl->getReturnType().isVoid() || !isBencherPointer(functionDecl->getParams()[0].getType())) continue;
+
+            benchmarks.push_back({functionDecl->getName().str(), mangleFunctionDecl(*functionDecl)});
+        }
+    }
+
+    return benchmarks;
+}
+
+static Measurement measure(BenchmarkFunctionPointer function, int32_t iterations) {
+    Bencher bencher = {iterations};
+    uint64_t allocationsBefore = allocationCount;
+    auto start = std::chrono::steady_clock::now();
+    function(&bencher);
+    auto end = std::chrono::steady_clock::now();
+    return {std::chrono::duration<double>(end - start).count(), allocationCount - allocationsBefore};
+}
+
+/// Returns an iteration count for which running the benchmark takes at least the given time. Each attempt predicts
+/// the count from the previous one's time per iteration, with some headroom, but grows it by at most 100x in case
+/// the first iterations were unusually fast.
+static int32_t getIterationCount(BenchmarkFunctionPointer function, double minimumSampleTime) {
+    int64_t iterations = 1;
+
+    while (true) {
+        auto measurement = measure(function, int32_t(iterations));
+        if (measurement.seconds >= minimumSampleTime || iterations == maxIterations) return int32_t(iterations);
+
+        double secondsPerIteration = std::max(measurement.seconds / iterations, 1e-9);
+        auto predictedIterations = int64_t(minimumSampleTime / secondsPerIteration * 1.2);
+        iterations = std::min({std::max(predictedIterations, iterations + 1), iterations * 100, int64_t(maxIterations)});
+    }
+}
+
+static BenchmarkResult runBenchmark(const BenchmarkFunction& benchmark, BenchmarkFunctionPointer function, const BenchmarkOptions& options) {
+    auto iterations = getIterationCount(function, options.minimumSampleTime);
+    std::vector<double> samples;
+    uint64_t allocations = 0;
+
+    for (unsigned i = 0; i < std::max(options.sampleCount, 1u); ++i) {
+        auto measurement = measure(function, iterations);
+        samples.push_back(measurement.seconds * 1e9 / iterations);
+        allocations += measurement.allocations;
+    }
+
+    double mean = 0;
+    for (double sample : samples) mean += sample;
+    mean /= samples.size();
+
+    double variance = 0;
+    for (double sample : samples) variance += (sample - mean) * (sample - mean);
+    if (samples.size() > 1) variance /= samples.size() - 1;
+
+    double variation = mean > 0 ? std::sqrt(variance) / mean * 100 : 0;
+    double allocationsPerOperation = double(allocations) / (double(iterations) * samples.size());
+    return {benchmark.name, iterations, mean, variation, allocationsPerOperation};
+}
+
+static llvm::StringMap<BenchmarkResult> readBaseline(llvm::StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) ABORT("couldn't read benchmark baseline '" << path << "': " << buffer.getError().message());
+
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    if (!json) ABORT("invalid benchmark baseline '" << path << "': " << llvm::toString(json.takeError()));
+
+    llvm::StringMap<BenchmarkResult> baseline;
+    auto* root = json->getAsObject();
+    auto* benchmarks = root ? root->getArray("benchmarks") : nullptr;
+    if (!benchmarks) ABORT("invalid benchmark baseline '" << path << "': expected a 'benchmarks' array");
+
+    for (auto& value : *benchmarks) {
+        auto* benchmark = value.getAsObject();
+        auto name = benchmark ? benchmark->getString("name") : llvm::None;
+        auto nanosecondsPerOperation = benchmark ? benchmark->getNumber("ns-per-op") : llvm::None;
+        auto allocationsPerOperation = benchmark ? benchmark->getNumber("allocs-per-op") : llvm::None;
+        if (!name || !nanosecondsPerOperation || !allocationsPerOperation) {
+            ABORT("invalid benchmark baseline '" << path << "': expected 'name', 'ns-per-op', and 'allocs-per-op' for each "
+                                                            "benchmark");
+        }
+        auto iterations = benchmark->getInteger("iterations");
+        auto variation = benchmark->getNumber("variation-percent");
+        baseline[*name] = {name->str(), iterations.getValueOr(0), *nanosecondsPerOperation, variation.getValueOr(0),
+                           *allocationsPerOperation};
+    }
+
+    return baseline;
+}
+
+static void writeResults(llvm::ArrayRef<BenchmarkResult> results, llvm::StringRef path) {
+    llvm::json::Array benchmarks;
+    for (auto& result : results) {
+        benchmarks.push_back(llvm::json::Object{{"name", result.name},
+                                                {"iterations", result.iterations},
+                                                {"ns-per-op", result.nanosecondsPerOperation},
+                                                {"variation-percent", result.variation},
+                                                {"allocs-per-op", result.allocationsPerOperation}});
+    }
+
+    std::error_code error;
+    llvm::raw_fd_ostream file(path, error, llvm::sys::fs::F_Text);
+    if (error) ABORT("couldn't write benchmark results to '" << path << "': " << error.message());
+    file << llvm::formatv("{0:2}", llvm::json::Value(llvm::json::Object{{"benchmarks", std::move(benchmarks)}})) << '\n';
+}
+
+/// Returns the relative change from the baseline value to the new value in percent.
+static double getChange(double baselineValue, double value) {
+    if (baselineValue == 0) return value == 0 ? 0 : std::numeric_limits<double>::infinity();
+    return (value - baselineValue) / baselineValue * 100;
+}
+
+static std::string formatChange(double change) {
+    if (std::isinf(change)) return "+inf%";
+    return llvm::formatv("{0}{1:f1}%", change >= 0 ? "+" : "", change).str();
+}
+
+int delta::runBenchmarks(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context,
+                         const llvm::TargetMachine& targetMachine, llvm::ArrayRef<BenchmarkFunction> benchmarks,
+                         const BenchmarkOptions& options) {
+    llvm::Regex filter(options.filter);
+    std::string filterError;
+    if (!filter.isValid(filterError)) ABORT("invalid benchmark filter '" << options.filter << "': " << filterError);
+
+    llvm::StringMap<BenchmarkResult> baseline;
+    if (!options.baselinePath.empty()) baseline = readBaseline(options.baselinePath);
+
+    std::pair<llvm::StringRef, void*> symbolOverrides[] = {{"malloc", reinterpret_cast<void*>(&countAllocation)},
+                                                           {"calloc", reinterpret_cast<void*>(&countZeroedAllocation)},
+                                                           {"realloc", reinterpret_cast<void*>(&countReallocation)}};
+    auto jit = createJIT(std::move(module), std::move(context), targetMachine, symbolOverrides);
+
+    std::vector<BenchmarkResult> results;
+    size_t nameWidth = 0;
+    for (auto& benchmark : benchmarks) {
+        nameWidth = std::max(nameWidth, benchmark.name.size());
+    }
+
+    int regressionCount = 0;
+
+    for (auto& benchmark : benchmarks) {
+        if (!filter.match(benchmark.name)) continue;
+
+        auto function = reinterpret_cast<BenchmarkFunctionPointer>(lookupJITSymbol(*jit, benchmark.mangledName));
+        auto result = runBenchmark(benchmark, function, options);
+        results.push_back(result);
+
+        llvm::outs() << llvm::left_justify(result.name, nameWidth);
+        llvm::outs() << llvm::formatv(" {0,12} {1,12:f2} ns/op +/-{2,5:f1}% {3,10:f2} allocs/op", result.iterations,
+                                      result.nanosecondsPerOperation, result.variation, result.allocationsPerOperation);
+
+        auto baselineResult = baseline.find(benchmark.name);
+        if (baselineResult != baseline.end()) {
+            double timeChange = getChange(baselineResult->second.nanosecondsPerOperation, result.nanosecondsPerOperation);
+            double allocationChange = getChange(baselineResult->second.allocationsPerOperation, result.allocationsPerOperation);
+            llvm::outs() << "  " << formatChange(timeChange) << " ns/op, " << formatChange(allocationChange) << " allocs/op vs. baseline";
+
+            if (timeChange > options.maximumRegression || allocationChange > options.maximumRegression) {
+                llvm::outs() << " (regression)";
+                regressionCount++;
+            }
+        }
+
+        llvm::outs() << '\n';
+        llvm::outs().flush();
+    }
+
+    if (results.empty()) {
+        llvm::outs() << "no benchmarks to run\n";
+    }
+
+    if (!options.outputPath.empty()) {
+        writeResults(results, options.outputPath);
+    }
+
+    if (regressionCount > 0) {
+        llvm::outs() << regressionCount << " benchmark" << (regressionCount == 1 ? "" : "s") << " regressed by more than "
+                     << options.maximumRegression << "% compared to the baseline\n";
+        return 1;
+    }
+
+    return 0;
+}
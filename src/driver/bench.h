@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#pragma warning(push, 0)
+#include <llvm/ADT/ArrayRef.h>
+#pragma warning(pop)
+
+namespace llvm {
+class LLVMContext;
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+namespace delta {
+
+class Module;
+
+/// A function that 'delta bench' runs as a benchmark.
+struct BenchmarkFunction {
+    std::string name;
+    std::string mangledName;
+};
+
+struct BenchmarkOptions {
+    /// Only benchmarks whose name matches this regular expression are run.
+    std::string filter;
+    /// The minimum duration of each sample, used for choosing the number of iterations.
+    double minimumSampleTime;
+    unsigned sampleCount;
+    /// JSON file containing the results of a previous run to compare against, or empty.
+    std::string baselinePath;
+    /// JSON file to write the results to, or empty.
+    std::string outputPath;
+    /// The increase in ns/op or allocations/op compared to the baseline, in percent, above which a benchmark is
+    /// considered to have regressed.
+    double maximumRegression;
+};
+
+/// Returns the non-generic top-level functions in the given module that take a single `Bencher*` parameter.
+std::vector<BenchmarkFunction> findBenchmarkFunctions(const Module& module);
+
+/// JIT-compiles the given module and runs the given benchmarks, printing their results. Returns 1 if any of them
+/// regressed compared to the baseline, otherwise 0.
+int runBenchmarks(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context,
+                  const llvm::TargetMachine& targetMachine, llvm::ArrayRef<BenchmarkFunction> benchmarks, const BenchmarkOptions& options);
+
+} // namespace delta
@@ -1,26 +1,74 @@
 #include "clang.h"
 #include <memory>
+#include <mutex>
 #include <utility>
 #pragma warning(push, 0)
 #include <clang/Basic/Diagnostic.h>
 #include <clang/Basic/DiagnosticIDs.h>
 #include <clang/Driver/Compilation.h>
 #include <clang/Driver/Driver.h>
+#include <clang/Driver/Tool.h>
+#include <clang/Driver/ToolChain.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
 #include <llvm/ADT/ArrayRef.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/VirtualFileSystem.h> // Fixes "error: invalid use of incomplete type ‘class llvm::vfs::FileSystem’" on GCC.
 #include <llvm/Support/raw_ostream.h>
+#ifdef DELTA_HAVE_LLD
+#include <lld/Common/Driver.h>
+#include <lld/Common/ErrorHandler.h>
+#endif
 #pragma warning(pop)
+#include "../support/stats.h"
+
+#ifdef DELTA_HAVE_LLD
+/// Returns the linker command if the compilation consists of nothing but linking an ELF file, which lld can do.
+static const clang::driver::Command* getELFLinkCommand(const clang::driver::Compilation& compilation) {
+    if (!compilation.getDefaultToolChain().getTriple().isOSBinFormatELF()) return nullptr;
+    if (compilation.getJobs().size() != 1) return nullptr;
+    auto& command = *compilation.getJobs().begin();
+    if (!command.getCreator().isLinkJob()) return nullptr;
+    return &command;
+}
 
-int delta::invokeClang(llvm::ArrayRef<const char*> args) {
+/// Runs the linker command with lld's ELF driver instead of spawning the linker chosen by the clang driver. The
+/// command's arguments, including the paths of the C runtime startup files and libraries, are resolved by the clang
+/// driver and are accepted by lld as they are GNU ld compatible.
+static int linkWithLLD(const clang::driver::Command& command) {
+    // lld keeps its state in global variables, so it can only run one link at a time.
+    static std::mutex lldMutex;
+    std::lock_guard<std::mutex> lock(lldMutex);
+
+    std::vector<const char*> args = {"ld.lld"};
+    args.insert(args.end(), command.getArguments().begin(), command.getArguments().end());
+    lld::errorHandler().errorCount = 0;
+    return lld::elf::link(args, false, llvm::errs()) ? 0 : 1;
+}
+#endif
+
+int delta::invokeClang(llvm::ArrayRef<const char*> args, bool useIntegratedLinker) {
     auto* diagClient = new clang::TextDiagnosticPrinter(llvm::errs(), new clang::DiagnosticOptions());
     diagClient->setPrefix(llvm::sys::path::filename(args[0]));
     clang::DiagnosticsEngine diags(new clang::DiagnosticIDs(), nullptr, diagClient);
     clang::driver::Driver driver(args[0], llvm::sys::getDefaultTargetTriple(), diags);
+    // The resource directory would otherwise be looked up relative to args[0], which is the Delta executable, so the
+    // driver wouldn't find the compiler runtime libraries, e.g. the profile runtime for -fprofile-instr-generate.
+    driver.ResourceDir = CLANG_RESOURCE_DIR;
     std::unique_ptr<clang::driver::Compilation> compilation(driver.BuildCompilation(args));
 
+#ifdef DELTA_HAVE_LLD
+    if (useIntegratedLinker && compilation && !compilation->containsError()) {
+        if (auto* linkCommand = getELFLinkCommand(*compilation)) {
+            diags.getClient()->finish();
+            addStatistic("link", "integrated-linker-links");
+            return linkWithLLD(*linkCommand);
+        }
+    }
+#else
+    (void) useIntegratedLinker;
+#endif
+
     int result = 1;
     if (compilation && !compilation->containsError()) {
         llvm::SmallVector<std::pair<int, const clang::driver::Command*>, 4> failingCommands;
@@ -7,6 +7,9 @@ class ArrayRef;
 
 namespace delta {
 
-int invokeClang(llvm::ArrayRef<const char*> args);
+/// Runs the clang driver with the given arguments. If useIntegratedLinker is true and the arguments only require
+/// linking an ELF executable, the linker command built by the driver is run in-process using the embedded lld, if
+/// delta was built with lld.
+int invokeClang(llvm::ArrayRef<const char*> args, bool useIntegratedLinker = false);
 
 } // namespace delta
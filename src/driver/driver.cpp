@@ -1,35 +1,62 @@
 #include "driver.h"
+#include <algorithm>
 #include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <system_error>
 #include <vector>
 #pragma warning(push, 0)
+#include <llvm/ADT/STLExtras.h>
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringSet.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/CodeGen/ParallelCG.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/MC/SubtargetFeature.h>
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
 #include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
 #include <llvm/Support/Program.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/TimeProfiler.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #pragma warning(pop)
+#include "bench.h"
 #include "clang.h"
+#include "jit.h"
+#include "lto.h"
+#include "server.h"
+#include "../ast/compilation-context.h"
 #include "../ast/module.h"
 #include "../irgen/irgen.h"
 #include "../package-manager/manifest.h"
 #include "../package-manager/package-manager.h"
 #include "../parser/parse.h"
+#include "../sema/c-import.h"
 #include "../sema/typecheck.h"
+#include "../support/stats.h"
 #include "../support/utility.h"
 
 #ifdef _MSC_VER
@@ -45,18 +72,105 @@ namespace delta {
 int errors = 0;
 cl::SubCommand build("build", "Build a Delta project");
 cl::SubCommand run("run", "Build and run a Delta executable");
+cl::SubCommand bench("bench", "Build and run the benchmark functions, i.e. the functions taking a Bencher* parameter");
+cl::SubCommand serve("serve", "Run a compile server that keeps the standard library and imported C headers loaded");
 cl::list<std::string> inputs(cl::Positional, cl::desc("<input files>"), cl::sub(*cl::AllSubCommands));
 cl::opt<bool> parse("parse", cl::desc("Parse only"));
 cl::opt<bool> typecheck("typecheck", cl::desc("Parse and type-check only"));
+cl::opt<bool> typecheckAll("fcheck-all",
+                           cl::desc("Typecheck the bodies of all functions in imported modules, not only the referenced ones"),
+                           cl::sub(*cl::AllSubCommands));
 cl::opt<bool> compileOnly("c", cl::desc("Compile only, generating an object file; don't link"));
 cl::opt<bool> printIR("print-ir", cl::desc("Print the generated LLVM IR to stdout"));
 cl::opt<bool> emitAssembly("emit-assembly", cl::desc("Emit assembly code"));
 cl::opt<bool> emitBitcode("emit-llvm-bitcode", cl::desc("Emit LLVM bitcode"));
 cl::opt<bool> emitPositionIndependentCode("fPIC", cl::desc("Emit position-independent code"), cl::sub(*cl::AllSubCommands));
+cl::opt<bool> noJIT("no-jit", cl::desc("Run the program by linking an executable instead of JIT-compiling it in-process"),
+                   cl::sub(run));
+cl::opt<unsigned> codegenThreads("j",
+                                 cl::desc("Number of threads to use for machine code generation and ThinLTO, and for compiling and "
+                                          "linking package targets concurrently (0 = number of CPU cores)"),
+                                 cl::value_desc("threads"), cl::init(1), cl::Prefix, cl::sub(*cl::AllSubCommands));
+cl::opt<unsigned> typecheckThreads("typecheck-threads",
+                                   cl::desc("Number of threads to use for typechecking the function bodies of the main module "
+                                            "(0 = number of CPU cores)"),
+                                   cl::value_desc("threads"), cl::init(1), cl::sub(*cl::AllSubCommands));
+cl::opt<bool> integratedLinker("integrated-linker",
+                               cl::desc("Link ELF executables in-process with the embedded lld instead of running the "
+                                        "system linker (if delta was built with lld)"),
+                               cl::sub(*cl::AllSubCommands));
+cl::opt<bool> useBuildCache("build-cache",
+                            cl::desc("Compile each module to a separate object file, reusing object files cached in the build cache "
+                                     "directory when the module's generated code hasn't changed"),
+                            cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> buildCacheDirectory("build-cache-dir", cl::desc("Build cache directory (default: .delta-cache)"),
+                                         cl::value_desc("path"), cl::init(".delta-cache"), cl::sub(*cl::AllSubCommands));
+cl::opt<bool> emitPrecompiledStdlib("emit-precompiled-stdlib",
+                                   cl::desc("Precompile the standard library into the file specified with -o"));
+cl::opt<std::string> precompiledStdlibPath("precompiled-stdlib",
+                                           cl::desc("Precompiled standard library to use (default: delta-std.bc next to the compiler)"),
+                                           cl::value_desc("path"), cl::sub(*cl::AllSubCommands));
+cl::opt<bool> noPrecompiledStdlib("no-precompiled-stdlib", cl::desc("Build the standard library from source"),
+                                  cl::sub(*cl::AllSubCommands));
+cl::opt<bool> timeTrace("ftime-trace", cl::desc("Write a Chrome trace of the time spent in each compilation phase"),
+                        cl::sub(*cl::AllSubCommands));
+cl::opt<unsigned> timeTraceGranularity("ftime-trace-granularity",
+                                       cl::desc("Minimum duration of trace events in microseconds (default: 500)"),
+                                       cl::value_desc("us"), cl::init(500), cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> timeTraceFile("ftime-trace-file", cl::desc("Output file for -ftime-trace (default: time-trace.json)"),
+                                   cl::value_desc("path"), cl::init("time-trace.json"), cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> printStats("print-stats", cl::ValueOptional,
+                                cl::desc("Print compiler statistics to stderr (-print-stats=json for JSON output)"),
+                                cl::value_desc("format"), cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> serverSocketPath("socket",
+                                      cl::desc("Socket to listen on (default: $DELTA_SERVER_SOCKET, or delta-server.sock in "
+                                               "$XDG_RUNTIME_DIR, or delta-server-<uid>.sock in the temporary directory)"),
+                                      cl::value_desc("path"), cl::sub(serve));
+cl::opt<std::string> benchmarkFilter("filter", cl::desc("Only run the benchmarks whose name matches the given regular expression"),
+                                     cl::value_desc("regex"), cl::sub(bench));
+cl::opt<double> benchmarkSampleTime("sample-time",
+                                    cl::desc("Minimum duration of each benchmark sample in seconds, used for choosing the number of "
+                                             "iterations (default: 0.5)"),
+                                    cl::value_desc("seconds"), cl::init(0.5), cl::sub(bench));
+cl::opt<unsigned> benchmarkSamples("samples", cl::desc("Number of samples to measure for each benchmark (default: 5)"), cl::init(5),
+                                   cl::sub(bench));
+cl::opt<std::string> benchmarkBaseline("baseline",
+                                       cl::desc("Compare the results to ones saved with -save, and exit with a nonzero status if a "
+                                                "benchmark regressed"),
+                                       cl::value_desc("file"), cl::sub(bench));
+cl::opt<std::string> benchmarkOutput("save", cl::desc("Save the results as JSON into the given file"), cl::value_desc("file"),
+                                     cl::sub(bench));
+cl::opt<double> benchmarkMaxRegression("max-regression",
+                                       cl::desc("Increase in ns/op or allocations/op compared to the baseline, in percent, above "
+                                                "which a benchmark is considered to have regressed (default: 5)"),
+                                       cl::value_desc("percent"), cl::init(5), cl::sub(bench));
 cl::opt<std::string> specifiedOutputFileName("o", cl::desc("Specify output file name"));
 cl::opt<WarningMode> warningMode(cl::desc("Warning mode:"), cl::sub(*cl::AllSubCommands),
                                  cl::values(clEnumValN(WarningMode::Suppress, "w", "Suppress all warnings"),
                                             clEnumValN(WarningMode::TreatAsErrors, "Werror", "Treat warnings as errors")));
+cl::opt<OptimizationLevel> optimizationLevel(cl::desc("Optimization level (default: -O2 for 'delta build', -O0 otherwise):"),
+                                           cl::sub(*cl::AllSubCommands),
+                                           cl::values(clEnumValN(OptimizationLevel::O0, "O0", "No optimization"),
+                                                      clEnumValN(OptimizationLevel::O1, "O1", "Basic optimizations"),
+                                                      clEnumValN(OptimizationLevel::O2, "O2", "Default optimizations"),
+                                                      clEnumValN(OptimizationLevel::O3, "O3", "Aggressive optimizations"),
+                                                      clEnumValN(OptimizationLevel::Os, "Os", "Optimize for code size")));
+cl::opt<LTOMode> ltoMode("flto", cl::desc("Optimize across modules, including .bc input files, at link time"),
+                         cl::init(LTOMode::None), cl::sub(*cl::AllSubCommands),
+                         cl::values(clEnumValN(LTOMode::Full, "full", "Merge all modules into one before optimizing"),
+                                    clEnumValN(LTOMode::Thin, "thin", "Optimize modules in parallel using module summaries")));
+cl::opt<std::string> profileGenerate("fprofile-generate", cl::ValueOptional,
+                                     cl::desc("Instrument the program to write an execution profile into the given directory "
+                                              "(default: current directory) when it exits"),
+                                     cl::value_desc("directory"), cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> profileUse("fprofile-use", cl::desc("Optimize using an execution profile merged with llvm-profdata"),
+                                cl::value_desc("file.profdata"), cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> targetArch("march", cl::desc("Generate code for the given CPU ('native' selects the host CPU and its features)"),
+                                cl::value_desc("cpu"), cl::sub(*cl::AllSubCommands));
+cl::opt<std::string> targetCPU("mcpu", cl::desc("Target a specific CPU type ('native' selects the host CPU and its features)"),
+                               cl::value_desc("cpu"), cl::sub(*cl::AllSubCommands));
+cl::list<std::string> targetFeatures("mattr", cl::CommaSeparated, cl::desc("Enable or disable target features"),
+                                     cl::value_desc("+feature,-feature"), cl::sub(*cl::AllSubCommands));
 cl::list<std::string> disabledWarnings("Wno-", cl::desc("Disable warnings"), cl::value_desc("warning"), cl::Prefix,
                                        cl::sub(*cl::AllSubCommands));
 cl::list<std::string> defines("D", cl::desc("Specify defines"), cl::Prefix, cl::sub(*cl::AllSubCommands));
@@ -66,6 +180,7 @@ cl::list<std::string> frameworkSearchPaths("F", cl::desc("Add directory framewor
                                            cl::sub(*cl::AllSubCommands));
 cl::list<std::string> cflags(cl::Sink, cl::desc("Add C compiler flags"), cl::sub(*cl::AllSubCommands));
 cl::alias emitAssemblyAlias("S", cl::aliasopt(emitAssembly));
+cl::alias codegenThreadsAlias("codegen-threads", cl::desc("Alias for -j"), cl::aliasopt(codegenThreads));
 } // namespace delta
 
 static int exec(const char* command, std::string& output) {
@@ -88,39 +203,53 @@ static int exec(const char* command, std::string& output) {
     return WEXITSTATUS(status);
 }
 
-static void addHeaderSearchPathsFromEnvVar(const char* name) {
+static void addHeaderSearchPathsFromEnvVar(std::vector<std::string>& searchPaths, const char* name) {
     if (auto pathList = llvm::sys::Process::GetEnv(name)) {
         llvm::SmallVector<llvm::StringRef, 16> paths;
         llvm::StringRef(*pathList).split(paths, llvm::sys::EnvPathSeparator, -1, false);
 
         for (llvm::StringRef path : paths) {
-            importSearchPaths.push_back(path);
+            searchPaths.push_back(path);
         }
     }
 }
 
-static void addHeaderSearchPathsFromCCompilerOutput() {
-    auto compilerPath = getCCompilerPath();
-    if (compilerPath.empty()) return;
-
-    if (llvm::sys::path::filename(compilerPath) != "cl.exe") {
-        std::string command = "echo | " + compilerPath + " -E -v - 2>&1 | grep '^ /'";
-        std::string output;
-        exec(command.c_str(), output);
-
-        llvm::SmallVector<llvm::StringRef, 8> lines;
-        llvm::SplitString(output, lines, "\n");
-
-        for (auto line : lines) {
-            auto path = line.trim();
-            if (llvm::sys::fs::is_directory(path)) {
-                importSearchPaths.push_back(path);
+static void addHeaderSearchPathsFromCCompilerOutput(std::vector<std::string>& searchPaths) {
+    // Cached so that the C compiler is only invoked once per compile server process. Locked because the frontends of
+    // package targets may run concurrently.
+    static std::vector<std::string> compilerHeaderSearchPaths;
+    static bool compilerHeaderSearchPathsFound = false;
+    static std::mutex compilerHeaderSearchPathsMutex;
+    std::lock_guard<std::mutex> lock(compilerHeaderSearchPathsMutex);
+
+    if (!compilerHeaderSearchPathsFound) {
+        compilerHeaderSearchPathsFound = true;
+        auto compilerPath = getCCompilerPath();
+        if (compilerPath.empty()) return;
+
+        if (llvm::sys::path::filename(compilerPath) != "cl.exe") {
+            std::string command = "echo | " + compilerPath + " -E -v - 2>&1 | grep '^ /'";
+            std::string output;
+            exec(command.c_str(), output);
+
+            llvm::SmallVector<llvm::StringRef, 8> lines;
+            llvm::SplitString(output, lines, "\n");
+
+            for (auto line : lines) {
+                auto path = line.trim();
+                if (llvm::sys::fs::is_directory(path)) {
+                    compilerHeaderSearchPaths.push_back(path);
+                }
             }
         }
     }
+
+    for (auto& path : compilerHeaderSearchPaths) {
+        searchPaths.push_back(path);
+    }
 }
 
-static void addPredefinedImportSearchPaths(llvm::ArrayRef<std::string> inputFiles) {
+static void addPredefinedImportSearchPaths(std::vector<std::string>& searchPaths, llvm::ArrayRef<std::string> inputFiles) {
     llvm::StringSet<> relativeImportSearchPaths;
 
     for (llvm::StringRef filePath : inputFiles) {
@@ -130,46 +259,203 @@ static void addPredefinedImportSearchPaths(llvm::ArrayRef<std::string> inputFile
     }
 
     for (auto& keyValue : relativeImportSearchPaths) {
-        importSearchPaths.push_back(keyValue.getKey());
+        searchPaths.push_back(keyValue.getKey());
     }
 
-    importSearchPaths.push_back(DELTA_ROOT_DIR);
-    importSearchPaths.push_back(CLANG_BUILTIN_INCLUDE_PATH);
+    searchPaths.push_back(DELTA_ROOT_DIR);
+    searchPaths.push_back(CLANG_BUILTIN_INCLUDE_PATH);
     // FIXME: Find a better way to find the correct libc header search path.
-    importSearchPaths.push_back(
-        "/Applications/Xcode.app/Contents/Developer/Platforms/MacOSX.platform/Developer/SDKs/MacOSX.sdk/usr/include");
-    importSearchPaths.push_back("/usr/include");
-    importSearchPaths.push_back("/usr/local/include");
-    addHeaderSearchPathsFromEnvVar("CPATH");
-    addHeaderSearchPathsFromEnvVar("C_INCLUDE_PATH");
-    addHeaderSearchPathsFromEnvVar("INCLUDE");
-    addHeaderSearchPathsFromCCompilerOutput();
-}
-
-static void emitMachineCode(llvm::Module& module, llvm::StringRef fileName, llvm::TargetMachine::CodeGenFileType fileType,
-                            llvm::Reloc::Model relocModel) {
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
+    searchPaths.push_back("/Applications/Xcode.app/Contents/Developer/Platforms/MacOSX.platform/Developer/SDKs/MacOSX.sdk/usr/include");
+    searchPaths.push_back("/usr/include");
+    searchPaths.push_back("/usr/local/include");
+    addHeaderSearchPathsFromEnvVar(searchPaths, "CPATH");
+    addHeaderSearchPathsFromEnvVar(searchPaths, "C_INCLUDE_PATH");
+    addHeaderSearchPathsFromEnvVar(searchPaths, "INCLUDE");
+    addHeaderSearchPathsFromCCompilerOutput(searchPaths);
+}
+
+/// Returns the number of threads to use for typechecking function bodies, as specified by -typecheck-threads.
+static unsigned getTypecheckThreadCount() {
+    // The time trace profiler doesn't support recording events from multiple threads.
+    if (timeTrace) return 1;
+    if (typecheckThreads == 0) return llvm::heavyweight_hardware_concurrency();
+    return typecheckThreads;
+}
 
+/// Returns the options for compiling the given files. The global option values are not modified, so that each
+/// target of a package gets its own import search paths.
+static CompileOptions getCompileOptions(llvm::ArrayRef<std::string> inputFiles) {
+    CompileOptions options = {disabledWarnings, importSearchPaths, frameworkSearchPaths, defines, cflags};
+    addPredefinedImportSearchPaths(options.importSearchPaths, inputFiles);
+    // -print-ir and the precompiled standard library generate code for all functions, so their bodies must be typechecked.
+    options.typecheckAllFunctionBodies = typecheckAll || printIR || emitPrecompiledStdlib;
+    options.typecheckThreadCount = getTypecheckThreadCount();
+    return options;
+}
+
+static OptimizationLevel getOptimizationLevel() {
+    if (optimizationLevel.getNumOccurrences() > 0) return optimizationLevel;
+    return build || bench ? OptimizationLevel::O2 : OptimizationLevel::O0;
+}
+
+static llvm::CodeGenOpt::Level getCodeGenOptLevel(OptimizationLevel level) {
+    switch (level) {
+        case OptimizationLevel::O0:
+            return llvm::CodeGenOpt::None;
+        case OptimizationLevel::O1:
+            return llvm::CodeGenOpt::Less;
+        case OptimizationLevel::O2:
+        case OptimizationLevel::Os:
+            return llvm::CodeGenOpt::Default;
+        case OptimizationLevel::O3:
+            return llvm::CodeGenOpt::Aggressive;
+    }
+    llvm_unreachable("invalid optimization level");
+}
+
+/// Returns the CPU name specified by -mcpu or -march, resolving 'native' to the host CPU.
+static std::string getTargetCPU() {
+    llvm::StringRef cpu = !targetCPU.empty() ? targetCPU : targetArch;
+    if (cpu.empty()) return "generic";
+    if (cpu == "native") return llvm::sys::getHostCPUName();
+    return cpu;
+}
+
+/// Returns the target feature string, consisting of the host CPU features if 'native' was specified,
+/// followed by the features specified by -mattr so that they can override the host features.
+static std::string getTargetFeatures() {
+    llvm::SubtargetFeatures features;
+
+    if (targetCPU == "native" || (targetCPU.empty() && targetArch == "native")) {
+        llvm::StringMap<bool> hostFeatures;
+        if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+            for (auto& feature : hostFeatures) {
+                features.AddFeature(feature.getKey(), feature.getValue());
+            }
+        }
+    }
+
+    for (auto& feature : targetFeatures) {
+        features.AddFeature(feature);
+    }
+
+    return features.getString();
+}
+
+static void setFunctionTargetAttributes(llvm::Module& module, llvm::StringRef cpu, llvm::StringRef features) {
+    for (auto& function : module) {
+        if (function.isDeclaration()) continue;
+        function.addFnAttr("target-cpu", cpu);
+        if (!features.empty()) function.addFnAttr("target-features", features);
+    }
+}
+
+static void setTargetProperties(llvm::Module& module, const llvm::TargetMachine& targetMachine, llvm::StringRef cpu,
+                                llvm::StringRef features) {
+    module.setTargetTriple(targetMachine.getTargetTriple().str());
+    module.setDataLayout(targetMachine.createDataLayout());
+    setFunctionTargetAttributes(module, cpu, features);
+}
+
+static std::unique_ptr<llvm::TargetMachine> createTargetMachine(llvm::StringRef cpu, llvm::StringRef features,
+                                                                llvm::Reloc::Model relocModel, OptimizationLevel optimizationLevel) {
     llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
     const std::string& targetTriple = triple.str();
-    module.setTargetTriple(targetTriple);
 
     std::string errorMessage;
     auto* target = llvm::TargetRegistry::lookupTarget(targetTriple, errorMessage);
     if (!target) ABORT(errorMessage);
 
     llvm::TargetOptions options;
-    auto* targetMachine = target->createTargetMachine(targetTriple, "generic", "", options, relocModel);
-    module.setDataLayout(targetMachine->createDataLayout());
+    auto codeGenOptLevel = getCodeGenOptLevel(optimizationLevel);
+    return std::unique_ptr<llvm::TargetMachine>(
+        target->createTargetMachine(targetTriple, cpu, features, options, relocModel, llvm::None, codeGenOptLevel));
+}
+
+static bool isProfileGenerationEnabled() {
+    return profileGenerate.getNumOccurrences() > 0;
+}
+
+/// Returns the path that the instrumented program writes its profile to. The profile runtime replaces %m with a
+/// signature of the program, so that different programs don't overwrite each other's profiles.
+static std::string getProfileOutputPath() {
+    llvm::SmallString<128> path(profileGenerate);
+    llvm::sys::path::append(path, "default_%m.profraw");
+    return path.str();
+}
+
+static unsigned getLLVMOptLevel(OptimizationLevel level) {
+    switch (level) {
+        case OptimizationLevel::O0:
+            return 0;
+        case OptimizationLevel::O1:
+            return 1;
+        case OptimizationLevel::O2:
+        case OptimizationLevel::Os:
+            return 2;
+        case OptimizationLevel::O3:
+            return 3;
+    }
+    llvm_unreachable("invalid optimization level");
+}
 
+/// Runs the standard LLVM module optimization pipeline corresponding to the given optimization level. When preparing
+/// for LTO, optimizations that work better after the modules have been combined are left to the LTO backend.
+/// The pipeline also inserts the profiling instrumentation for -fprofile-generate, or annotates the IR with the
+/// branch weights and function entry counts from the -fprofile-use profile. Profile records are looked up by the
+/// LLVM function names, i.e. the mangled names of the Delta functions.
+static void optimizeModule(llvm::Module& module, llvm::TargetMachine& targetMachine, OptimizationLevel optimizationLevel,
+                           LTOMode ltoMode = LTOMode::None) {
+    if (optimizationLevel == OptimizationLevel::O0 && !isProfileGenerationEnabled() && profileUse.empty()) return;
+
+    llvm::TimeTraceScope timeScope("Optimize", module.getName());
+    PhaseStatistics phaseStatistics("optimize");
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = getLLVMOptLevel(optimizationLevel);
+    builder.SizeLevel = optimizationLevel == OptimizationLevel::Os ? 1 : 0;
+    builder.PrepareForLTO = ltoMode == LTOMode::Full;
+    builder.PrepareForThinLTO = ltoMode == LTOMode::Thin;
+    builder.EnablePGOInstrGen = isProfileGenerationEnabled();
+    if (isProfileGenerationEnabled()) builder.PGOInstrGen = getProfileOutputPath();
+    builder.PGOInstrUse = profileUse;
+    builder.LibraryInfo = new llvm::TargetLibraryInfoImpl(llvm::Triple(module.getTargetTriple()));
+    builder.LoopVectorize = builder.OptLevel > 1 && builder.SizeLevel == 0;
+    builder.SLPVectorize = builder.OptLevel > 1 && builder.SizeLevel == 0;
+
+    if (builder.OptLevel > 1) {
+        builder.Inliner = llvm::createFunctionInliningPass(builder.OptLevel, builder.SizeLevel, false);
+    } else {
+        builder.Inliner = llvm::createAlwaysInlinerLegacyPass();
+    }
+
+    targetMachine.adjustPassManager(builder);
+
+    llvm::legacy::FunctionPassManager functionPassManager(&module);
+    functionPassManager.add(llvm::createTargetTransformInfoWrapperPass(targetMachine.getTargetIRAnalysis()));
+    builder.populateFunctionPassManager(functionPassManager);
+
+    llvm::legacy::PassManager modulePassManager;
+    modulePassManager.add(llvm::createTargetTransformInfoWrapperPass(targetMachine.getTargetIRAnalysis()));
+    builder.populateModulePassManager(modulePassManager);
+
+    functionPassManager.doInitialization();
+    for (auto& function : module) {
+        functionPassManager.run(function);
+    }
+    functionPassManager.doFinalization();
+    modulePassManager.run(module);
+}
+
+static void emitMachineCode(llvm::Module& module, llvm::TargetMachine& targetMachine, llvm::StringRef fileName,
+                            llvm::TargetMachine::CodeGenFileType fileType) {
+    llvm::TimeTraceScope timeScope("Emit machine code", fileName);
+    PhaseStatistics phaseStatistics("emit-machine-code");
     std::error_code error;
     llvm::raw_fd_ostream file(fileName, error, llvm::sys::fs::F_None);
     if (error) ABORT(error.message());
 
     llvm::legacy::PassManager passManager;
-    if (targetMachine->addPassesToEmitFile(passManager, file, nullptr, fileType)) {
+    if (targetMachine.addPassesToEmitFile(passManager, file, nullptr, fileType)) {
         ABORT("TargetMachine can't emit a file of this type");
     }
 
@@ -177,103 +463,572 @@ static void emitMachineCode(llvm::Module& module, llvm::StringRef fileName, llvm
     file.flush();
 }
 
-static void emitLLVMBitcode(const llvm::Module& module, llvm::StringRef fileName) {
+/// Splits the module into as many partitions as there are output files, and generates machine code for them
+/// concurrently, each partition using its own LLVMContext and TargetMachine.
+static void emitMachineCodeInParallel(std::unique_ptr<llvm::Module> module, llvm::ArrayRef<std::string> fileNames,
+                                      llvm::TargetMachine::CodeGenFileType fileType,
+                                      const std::function<std::unique_ptr<llvm::TargetMachine>()>& createTargetMachine) {
+    PhaseStatistics phaseStatistics("emit-machine-code");
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> files;
+
+    for (auto& fileName : fileNames) {
+        std::error_code error;
+        files.push_back(llvm::make_unique<llvm::raw_fd_ostream>(fileName, error, llvm::sys::fs::F_None));
+        if (error) ABORT(error.message());
+    }
+
+    auto streams = map(files, [](auto& file) -> llvm::raw_pwrite_stream* { return file.get(); });
+    llvm::splitCodeGen(std::move(module), streams, {}, createTargetMachine, fileType);
+
+    for (auto& file : files) {
+        file->flush();
+    }
+}
+
+/// Returns a hex-encoded SHA-1 hash of the given file's contents, or an empty string if the file can't be read.
+static std::string getFileHash(llvm::StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) return "";
+    llvm::SHA1 hasher;
+    hasher.update((*buffer)->getBuffer());
+    return llvm::toHex(hasher.final(), true);
+}
+
+/// Returns a string identifying the running compiler executable, so that cached build artifacts are invalidated
+/// when the compiler is rebuilt or upgraded.
+static std::string getCompilerIdentity(const char* argv0) {
+    auto executablePath = llvm::sys::fs::getMainExecutable(argv0, reinterpret_cast<void*>(&getCompilerIdentity));
+    llvm::sys::fs::file_status status;
+    if (auto error = llvm::sys::fs::status(executablePath, status)) {
+        ABORT("couldn't get status of '" << executablePath << "': " << error.message());
+    }
+    auto modificationTime = status.getLastModificationTime().time_since_epoch().count();
+    return (llvm::Twine(executablePath) + ":" + llvm::Twine(status.getSize()) + ":" + llvm::Twine(modificationTime)).str();
+}
+
+/// Returns the path of an object file compiled from the given module, stored in the build cache directory under a
+/// hash of the module's unoptimized IR, the compiler executable, and the code generation options. The object file
+/// is only generated if it doesn't already exist in the cache. Because the key is computed from the generated IR,
+/// a cache hit only skips optimization and machine code generation: parsing, typechecking, and IR generation still
+/// run on every build.
+static std::string emitCachedObjectFile(llvm::Module& module, llvm::TargetMachine& targetMachine, OptimizationLevel optimizationLevel,
+                                        llvm::StringRef compilerIdentity, llvm::StringRef objectFileExtension) {
+    llvm::SmallString<0> bitcode;
+    llvm::raw_svector_ostream bitcodeStream(bitcode);
+    llvm::WriteBitcodeToFile(module, bitcodeStream);
+
+    llvm::SHA1 hasher;
+    hasher.update(compilerIdentity);
+    hasher.update(targetMachine.getTargetTriple().str());
+    hasher.update(targetMachine.getTargetCPU());
+    hasher.update(targetMachine.getTargetFeatureString());
+    hasher.update(std::to_string(static_cast<int>(optimizationLevel)));
+    hasher.update(std::to_string(static_cast<int>(targetMachine.getRelocationModel())));
+    hasher.update(isProfileGenerationEnabled() ? getProfileOutputPath() : "");
+    hasher.update(profileUse.empty() ? "" : getFileHash(profileUse));
+    hasher.update(bitcode);
+
+    llvm::SmallString<128> objectFilePath(buildCacheDirectory);
+    llvm::sys::path::append(objectFilePath, llvm::toHex(hasher.final(), true) + "." + objectFileExtension);
+    if (llvm::sys::fs::exists(objectFilePath)) {
+        addStatistic("build-cache", "hits");
+        return objectFilePath.str();
+    }
+
+    addStatistic("build-cache", "misses");
+
+    if (auto error = llvm::sys::fs::create_directories(buildCacheDirectory)) {
+        ABORT("couldn't create build cache directory '" << buildCacheDirectory << "': " << error.message());
+    }
+
+    // Emit into a uniquely named file in the cache directory and then rename it, so that concurrent or interrupted
+    // builds never observe a partially written object file.
+    llvm::SmallString<128> temporaryObjectFilePath(buildCacheDirectory);
+    llvm::sys::path::append(temporaryObjectFilePath, "tmp-%%%%%%%%");
+    llvm::sys::fs::createUniquePath(temporaryObjectFilePath, temporaryObjectFilePath, false);
+
+    optimizeModule(module, targetMachine, optimizationLevel);
+    emitMachineCode(module, targetMachine, temporaryObjectFilePath, llvm::TargetMachine::CGFT_ObjectFile);
+
+    if (auto error = llvm::sys::fs::rename(temporaryObjectFilePath, objectFilePath)) {
+        ABORT("couldn't move '" << temporaryObjectFilePath << "' to '" << objectFilePath << "': " << error.message());
+    }
+
+    return objectFilePath.str();
+}
+
+static const char precompiledStdlibKeyName[] = "delta.precompiled-stdlib.key";
+
+static std::string getPrecompiledStdlibPath(const char* argv0) {
+    if (!precompiledStdlibPath.empty()) return precompiledStdlibPath;
+    auto executablePath = llvm::sys::fs::getMainExecutable(argv0, reinterpret_cast<void*>(&getPrecompiledStdlibPath));
+    llvm::SmallString<128> path = llvm::sys::path::parent_path(executablePath);
+    llvm::sys::path::append(path, "delta-std.bc");
+    return path.str();
+}
+
+/// Returns a hash of everything the precompiled standard library depends on: its source files, the compiler
+/// executable, the defines, and the target. Returns an empty string if the source files couldn't be read.
+static std::string getPrecompiledStdlibKey(const CompileOptions& options, const char* argv0) {
+    llvm::SHA1 hasher;
+    hasher.update(getCompilerIdentity(argv0));
+    hasher.update(llvm::sys::getDefaultTargetTriple());
+
+    for (auto& define : options.defines) {
+        hasher.update(define);
+        hasher.update(";");
+    }
+
+    // Find the standard library directory the same way Typechecker::importDeltaModule does.
+    auto importPath = llvm::find_if(options.importSearchPaths, [](llvm::StringRef importPath) {
+        return llvm::sys::fs::is_directory(importPath + "/std");
+    });
+    if (importPath == options.importSearchPaths.end()) return "";
+
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (llvm::sys::fs::recursive_directory_iterator it(*importPath + "/std", error), end; it != end; it.increment(error)) {
+        if (error) return "";
+        if (llvm::sys::path::extension(it->path()) == ".delta") {
+            paths.push_back(it->path());
+        }
+    }
+    llvm::sort(paths);
+
+    for (auto& path : paths) {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer) return "";
+        hasher.update(path);
+        hasher.update((*buffer)->getBuffer());
+    }
+
+    return llvm::toHex(hasher.final(), true);
+}
+
+/// Loads the precompiled standard library bitcode, or returns null if it doesn't exist or is out of date.
+static std::unique_ptr<llvm::Module> loadPrecompiledStdlib(llvm::LLVMContext& context, const CompileOptions& options,
+                                                          const char* argv0) {
+    auto buffer = llvm::MemoryBuffer::getFile(getPrecompiledStdlibPath(argv0));
+    if (!buffer) return nullptr;
+
+    auto module = llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), context);
+    if (!module) {
+        llvm::consumeError(module.takeError());
+        return nullptr;
+    }
+
+    auto* keyMetadata = (*module)->getNamedMetadata(precompiledStdlibKeyName);
+    if (!keyMetadata || keyMetadata->getNumOperands() != 1) return nullptr;
+    auto* key = llvm::dyn_cast<llvm::MDString>(keyMetadata->getOperand(0)->getOperand(0));
+    auto expectedKey = getPrecompiledStdlibKey(options, argv0);
+    if (!key || expectedKey.empty() || key->getString() != expectedKey) return nullptr;
+
+    (*module)->eraseNamedMetadata(keyMetadata);
+    return std::move(*module);
+}
+
+/// Turns function definitions that are also provided by the precompiled standard library into declarations.
+/// These are generic instantiations that are generated both into the precompiled standard library and into the
+/// modules using them.
+static void removeDefinitionsProvidedBy(const llvm::Module& precompiledModule, llvm::Module& module) {
+    for (auto& function : module) {
+        if (function.isDeclaration()) continue;
+
+        if (auto* precompiledFunction = precompiledModule.getFunction(function.getName())) {
+            if (!precompiledFunction->isDeclaration()) {
+                function.deleteBody();
+            }
+        }
+    }
+}
+
+static unsigned getCodegenThreadCount() {
+    // The time trace profiler doesn't support recording events from multiple threads.
+    if (timeTrace) return 1;
+    if (codegenThreads == 0) return llvm::heavyweight_hardware_concurrency();
+    return codegenThreads;
+}
+
+static void addIRStatistics(const llvm::Module& module) {
+    uint64_t functionCount = 0;
+    uint64_t instructionCount = 0;
+
+    for (auto& function : module) {
+        if (function.isDeclaration()) continue;
+        functionCount++;
+        instructionCount += function.getInstructionCount();
+    }
+
+    addStatistic("ir.functions", module.getName(), functionCount);
+    addStatistic("ir.instructions", module.getName(), instructionCount);
+}
+
+static void emitLLVMBitcode(const llvm::Module& module, llvm::StringRef fileName, LTOMode ltoMode = LTOMode::None) {
     std::error_code error;
     llvm::raw_fd_ostream file(fileName, error, llvm::sys::fs::F_None);
     if (error) ABORT(error.message());
-    llvm::WriteBitcodeToFile(module, file);
+    writeLTOBitcode(module, file, ltoMode);
     file.flush();
 }
 
-static int buildExecutable(llvm::ArrayRef<std::string> files, const PackageManifest* manifest, const char* argv0,
-                           llvm::StringRef outputDirectory, std::string outputFileName) {
+static std::unique_ptr<llvm::Module> loadBitcodeFile(llvm::LLVMContext& context, llvm::StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) ABORT("couldn't read '" << path << "': " << buffer.getError().message());
+
+    auto ltoInfo = llvm::getBitcodeLTOInfo((*buffer)->getMemBufferRef());
+    if (!ltoInfo) ABORT("couldn't read '" << path << "': " << llvm::toString(ltoInfo.takeError()));
+    addStatistic("bitcode-inputs", ltoInfo->HasSummary ? "with-summary" : "without-summary");
+
+    auto module = llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), context);
+    if (!module) ABORT("couldn't read '" << path << "': " << llvm::toString(module.takeError()));
+    return std::move(*module);
+}
+
+/// Returns true if the program can be JIT-compiled and run in-process, i.e. it doesn't need to be linked against
+/// additional libraries or object files specified as C compiler flags.
+static bool canRunInProcess(llvm::ArrayRef<std::string> cflags) {
+    return llvm::none_of(cflags, [](llvm::StringRef cflag) {
+        return cflag.startswith("-l") || cflag.startswith("-L") || cflag.endswith(".o") || cflag.endswith(".a") || cflag.endswith(".so");
+    });
+}
+
+/// Returns true if object files or libraries specified as C compiler flags may reference symbols defined in the
+/// generated code, in which case LTO must keep all of them. System libraries specified with -l are assumed not to.
+static bool hasNativeObjectInputs(llvm::ArrayRef<std::string> cflags) {
+    return llvm::any_of(cflags, [](llvm::StringRef cflag) {
+        return !cflag.startswith("-") && (cflag.endswith(".o") || cflag.endswith(".obj") || cflag.endswith(".a") ||
+                                          cflag.endswith(".lib") || cflag.endswith(".so") || cflag.endswith(".dylib"));
+    });
+}
+
+/// The LLVM modules generated for an executable or library, and everything else needed for optimizing, compiling,
+/// and linking them. This doesn't refer to the AST, so that the backend can run concurrently with the frontend
+/// compiling the next target.
+struct BackendJob {
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::vector<llvm::Module*> generatedModules;
+    CompileOptions options;
+    std::vector<std::string> files;
+    std::string outputDirectory;
+    std::string outputFileName;
+    std::string argv0;
+    bool compileOnly;
+    unsigned codegenThreadCount;
+    std::vector<BenchmarkFunction> benchmarks;
+};
+
+/// Removes the given module from the imported modules, so that it's imported again when needed. The module itself is
+/// leaked, because other modules may still refer to it.
+static void discardImportedModule(Module& module) {
+    Typechecker::forgetUncheckedFunctionBodies(module);
+    Module::getAllImportedModulesMap().erase(module.getName());
+}
+
+static void discardImportedModules() {
+    for (auto* module : Module::getAllImportedModules()) {
+        discardImportedModule(*module);
+    }
+}
+
+/// Returns true if errors have been reported, including ones collected by the current thread's diagnostic buffer that
+/// haven't been printed yet.
+static bool hasErrors() {
+    auto* diagnostics = DiagnosticBuffer::getCurrent();
+    return errors != 0 || (diagnostics && diagnostics->getErrorCount() != 0);
+}
+
+static void initializeNativeTarget() {
+    // Registering the target isn't thread-safe, and the frontends of package targets may run concurrently.
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
+}
+
+/// Parses, typechecks, and generates IR for the given files, and loads the given LLVM bitcode (.bc) files to be
+/// linked with the generated IR. Returns null if there's nothing left to do, e.g. because of errors or -typecheck,
+/// in which case the exit status is stored in exitStatus.
+static std::unique_ptr<BackendJob> runFrontend(llvm::ArrayRef<std::string> files, const PackageManifest* manifest, const char* argv0,
+                                               llvm::StringRef outputDirectory, std::string outputFileName, int& exitStatus) {
     if (files.empty()) {
         ABORT("no input files");
     }
 
-    addPredefinedImportSearchPaths(files);
+    std::vector<std::string> sourceFiles;
+    std::vector<std::string> bitcodeFiles;
 
-    CompileOptions options = {disabledWarnings, importSearchPaths, frameworkSearchPaths, defines, cflags};
+    for (auto& file : files) {
+        if (llvm::sys::path::extension(file) == ".bc") {
+            bitcodeFiles.push_back(file);
+        } else {
+            sourceFiles.push_back(file);
+        }
+    }
+
+    auto options = getCompileOptions(sourceFiles);
 
     if (!specifiedOutputFileName.empty()) {
         outputFileName = specifiedOutputFileName;
     }
 
+    exitStatus = 0;
     Module module("main");
 
-    for (llvm::StringRef filePath : files) {
-        Parser parser(filePath, module, options);
-        parser.parse();
+    {
+        llvm::TimeTraceScope timeScope("Frontend", llvm::StringRef(""));
+        PhaseStatistics phaseStatistics("parse");
+
+        for (llvm::StringRef filePath : sourceFiles) {
+            Parser parser(filePath, module, options);
+            parser.parse();
+        }
     }
 
-    if (parse) return errors ? 1 : 0;
+    if (parse) {
+        exitStatus = hasErrors() ? 1 : 0;
+        return nullptr;
+    }
 
-    Typechecker typechecker(options);
-    for (auto& importedModule : module.getImportedModules()) {
-        typechecker.typecheckModule(*importedModule, nullptr);
+    auto context = llvm::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> precompiledStdlib;
+
+    // The IR printed by -print-ir would be different when the standard library is precompiled, because generic
+    // instantiations used by the standard library would be generated into the printed module.
+    if (!noPrecompiledStdlib && !printIR) {
+        precompiledStdlib = loadPrecompiledStdlib(*context, options, argv0);
+        options.usePrecompiledStdlib = precompiledStdlib != nullptr;
     }
-    typechecker.typecheckModule(module, manifest);
 
-    if (errors) return 1;
-    if (typecheck) return 0;
+    // The compile server may have loaded the standard library with the opposite settings.
+    if (auto* stdModule = Module::getStdlibModule()) {
+        if (stdModule->isPrecompiled() != options.usePrecompiledStdlib ||
+            (options.typecheckAllFunctionBodies && Typechecker::hasUncheckedFunctionBodies(*stdModule))) {
+            discardImportedModule(*stdModule);
+        }
+    }
+
+    {
+        llvm::TimeTraceScope timeScope("Typecheck", llvm::StringRef(""));
+        PhaseStatistics phaseStatistics("typecheck");
+        Typechecker typechecker(options);
+        for (auto& importedModule : module.getImportedModules()) {
+            typechecker.typecheckModule(*importedModule, nullptr);
+        }
+        typechecker.typecheckModule(module, manifest);
+    }
 
-    IRGenerator irGenerator;
+    if (collectStatistics) {
+        addStatistic("typecheck", "unchecked-function-bodies", Typechecker::getUncheckedFunctionBodyCount());
+    }
 
-    for (auto* module : Module::getAllImportedModules()) {
-        irGenerator.codegenModule(*module);
+    if (hasErrors() || typecheck) {
+        exitStatus = hasErrors() ? 1 : 0;
+        return nullptr;
+    }
+
+    IRGenerator irGenerator(*context);
+    llvm::Module* mainModule;
+
+    {
+        llvm::TimeTraceScope timeScope("Codegen", llvm::StringRef(""));
+        PhaseStatistics phaseStatistics("codegen");
+
+        // Only the referenced functions of the imported modules are generated. -print-ir generates them in full, so
+        // that generic instantiations also used by the imported modules aren't generated into the printed module.
+        for (auto* module : Module::getAllImportedModules()) {
+            irGenerator.codegenModule(*module, !printIR);
+        }
+
+        mainModule = &irGenerator.codegenModule(module);
     }
 
-    auto& mainModule = irGenerator.codegenModule(module);
+    if (collectStatistics) {
+        addStatistic("codegen", "generated-functions", irGenerator.getGeneratedFunctionCount());
+        addStatistic("codegen", "skipped-functions", irGenerator.getSkippedFunctionCount());
+    }
 
     if (printIR) {
-        mainModule.setModuleIdentifier("");
-        mainModule.setSourceFileName("");
-        mainModule.print(llvm::outs(), nullptr);
-        return 0;
+        mainModule->setModuleIdentifier("");
+        mainModule->setSourceFileName("");
+        // Only added when requested, so that the printed IR doesn't depend on the host by default.
+        if (!targetCPU.empty() || !targetArch.empty() || !targetFeatures.empty()) {
+            setFunctionTargetAttributes(*mainModule, getTargetCPU(), getTargetFeatures());
+        }
+        mainModule->print(llvm::outs(), nullptr);
+        return nullptr;
+    }
+
+    auto generatedModules = irGenerator.getGeneratedModules();
+
+    if (collectStatistics) {
+        for (auto* generatedModule : generatedModules) {
+            addIRStatistics(*generatedModule);
+        }
     }
 
-    llvm::Module linkedModule("", irGenerator.getLLVMContext());
-    llvm::Linker linker(linkedModule);
+    if (precompiledStdlib) {
+        if (collectStatistics) {
+            auto precompiledFunctionCount = llvm::count_if(*precompiledStdlib, [](auto& function) { return !function.isDeclaration(); });
+            addStatistic("precompiled-stdlib", "loaded-functions", precompiledFunctionCount);
+        }
 
-    for (auto& module : irGenerator.getGeneratedModules()) {
-        bool error = linker.linkInModule(std::unique_ptr<llvm::Module>(module));
-        if (error) ABORT("LLVM module linking failed");
+        for (auto* generatedModule : generatedModules) {
+            removeDefinitionsProvidedBy(*precompiledStdlib, *generatedModule);
+        }
+        generatedModules.push_back(precompiledStdlib.release());
     }
 
-    if (emitBitcode) {
-        emitLLVMBitcode(linkedModule, "output.bc");
-        return 0;
+    for (auto& bitcodeFile : bitcodeFiles) {
+        generatedModules.push_back(loadBitcodeFile(*context, bitcodeFile).release());
     }
 
+    bool treatAsLibrary = module.getSymbolTable().find("main").empty() && !run;
+
+    initializeNativeTarget();
+
+    auto job = llvm::make_unique<BackendJob>();
+    job->context = std::move(context);
+    job->generatedModules = std::move(generatedModules);
+    job->options = std::move(options);
+    job->files = files;
+    job->outputDirectory = outputDirectory;
+    job->outputFileName = std::move(outputFileName);
+    job->argv0 = argv0;
+    job->compileOnly = compileOnly || treatAsLibrary;
+    job->codegenThreadCount = getCodegenThreadCount();
+    if (bench) job->benchmarks = findBenchmarkFunctions(module);
+    return job;
+}
+
+/// Optimizes, compiles, and links the modules generated by runFrontend. This may run on a different thread than
+/// the frontend, so it must not modify global state.
+static int runBackend(BackendJob& job) {
+    auto& context = job.context;
+    auto& generatedModules = job.generatedModules;
+    auto& options = job.options;
+    llvm::ArrayRef<std::string> files = job.files;
+    llvm::StringRef outputDirectory = job.outputDirectory;
+    auto& outputFileName = job.outputFileName;
+    const char* argv0 = job.argv0.c_str();
+    bool compileOnly = job.compileOnly;
+
     auto ccPath = getCCompilerPath();
     bool msvc = llvm::sys::path::extension(ccPath) == ".exe";
+    auto relocModel = emitPositionIndependentCode || msvc ? llvm::Reloc::Model::PIC_ : llvm::Reloc::Model::Static;
 
-    llvm::SmallString<128> temporaryOutputFilePath;
-    auto* outputFileExtension = emitAssembly ? "s" : msvc ? "obj" : "o";
-    if (auto error = llvm::sys::fs::createTemporaryFile("delta", outputFileExtension, temporaryOutputFilePath)) {
-        ABORT(error.message());
-    }
-
-    auto fileType = emitAssembly ? llvm::TargetMachine::CGFT_AssemblyFile : llvm::TargetMachine::CGFT_ObjectFile;
-    if (msvc) emitPositionIndependentCode = true;
-    auto relocModel = emitPositionIndependentCode ? llvm::Reloc::Model::PIC_ : llvm::Reloc::Model::Static;
-    emitMachineCode(linkedModule, temporaryOutputFilePath, fileType, relocModel);
+    auto optimizationLevel = getOptimizationLevel();
+    auto cpu = getTargetCPU();
+    auto features = getTargetFeatures();
+    auto targetMachine = createTargetMachine(cpu, features, relocModel, optimizationLevel);
 
     if (!outputDirectory.empty()) {
         auto error = llvm::sys::fs::create_directories(outputDirectory);
         if (error) ABORT(error.message());
     }
 
-    bool treatAsLibrary = module.getSymbolTable().find("main").empty() && !run;
-    if (treatAsLibrary) {
-        compileOnly = true;
+    if (isProfileGenerationEnabled() && msvc) {
+        ABORT("-fprofile-generate is not supported when linking with MSVC");
     }
 
-    if (compileOnly || emitAssembly) {
-        llvm::SmallString<128> outputFilePath = outputDirectory;
-        llvm::sys::path::append(outputFilePath, llvm::Twine("output.") + outputFileExtension);
-        renameFile(temporaryOutputFilePath, outputFilePath);
-        return 0;
+    // Benchmarks are JIT-compiled so that their allocations can be counted by intercepting malloc.
+    if (bench && !canRunInProcess(options.cflags)) {
+        ABORT("'delta bench' doesn't support linking additional libraries or object files");
+    }
+
+    // The profiling instrumentation needs the profile runtime library, which is only linked into executables.
+    bool runInProcess = run && !noJIT && !msvc && ltoMode == LTOMode::None && !isProfileGenerationEnabled() &&
+                        canRunInProcess(options.cflags);
+    auto* outputFileExtension = emitAssembly ? "s" : msvc ? "obj" : "o";
+    std::vector<std::string> objectFilePaths;
+    std::vector<std::string> temporaryOutputFilePaths;
+
+    if (ltoMode != LTOMode::None && !emitBitcode && !compileOnly && !emitAssembly && !bench) {
+        std::vector<std::unique_ptr<llvm::Module>> modules;
+
+        for (auto* generatedModule : generatedModules) {
+            std::unique_ptr<llvm::Module> module(generatedModule);
+            setTargetProperties(*module, *targetMachine, cpu, features);
+            optimizeModule(*module, *targetMachine, optimizationLevel, ltoMode);
+            modules.push_back(std::move(module));
+        }
+
+        objectFilePaths = compileWithLTO(std::move(modules), ltoMode, *targetMachine, getLLVMOptLevel(optimizationLevel),
+                                         job.codegenThreadCount, hasNativeObjectInputs(options.cflags), outputFileExtension);
+        temporaryOutputFilePaths = objectFilePaths;
+    } else if (useBuildCache && !emitBitcode && !compileOnly && !emitAssembly && !runInProcess && !bench) {
+        auto compilerIdentity = getCompilerIdentity(argv0);
+
+        for (auto* generatedModule : generatedModules) {
+            std::unique_ptr<llvm::Module> module(generatedModule);
+            setTargetProperties(*module, *targetMachine, cpu, features);
+            objectFilePaths.push_back(
+                emitCachedObjectFile(*module, *targetMachine, optimizationLevel, compilerIdentity, outputFileExtension));
+        }
+    } else {
+        auto linkedModule = llvm::make_unique<llvm::Module>("", *context);
+
+        {
+            llvm::TimeTraceScope timeScope("Link modules", llvm::StringRef(""));
+            PhaseStatistics phaseStatistics("link-modules");
+            llvm::Linker linker(*linkedModule);
+
+            for (auto* module : generatedModules) {
+                bool error = linker.linkInModule(std::unique_ptr<llvm::Module>(module));
+                if (error) ABORT("LLVM module linking failed");
+            }
+        }
+
+        setTargetProperties(*linkedModule, *targetMachine, cpu, features);
+        optimizeModule(*linkedModule, *targetMachine, optimizationLevel, emitBitcode ? ltoMode : LTOMode::None);
+
+        // With -flto, the bitcode is meant to be used as an input for a later LTO link.
+        if (emitBitcode) {
+            emitLLVMBitcode(*linkedModule, "output.bc", ltoMode);
+            return 0;
+        }
+
+        if (runInProcess) {
+            llvm::TimeTraceScope timeScope("Run", llvm::StringRef(""));
+            return runJIT(std::move(linkedModule), std::move(context), *targetMachine);
+        }
+
+        if (bench) {
+            llvm::TimeTraceScope timeScope("Run", llvm::StringRef(""));
+            BenchmarkOptions benchmarkOptions = {benchmarkFilter,   benchmarkSampleTime, benchmarkSamples,
+                                                 benchmarkBaseline, benchmarkOutput,     benchmarkMaxRegression};
+            return runBenchmarks(std::move(linkedModule), std::move(context), *targetMachine, job.benchmarks, benchmarkOptions);
+        }
+
+        // Parallel code generation produces multiple object files, so it's only used when linking an executable.
+        unsigned partitionCount = compileOnly || emitAssembly ? 1 : std::max(job.codegenThreadCount, 1u);
+
+        for (unsigned i = 0; i < partitionCount; ++i) {
+            llvm::SmallString<128> temporaryOutputFilePath;
+            if (auto error = llvm::sys::fs::createTemporaryFile("delta", outputFileExtension, temporaryOutputFilePath)) {
+                ABORT(error.message());
+            }
+            temporaryOutputFilePaths.push_back(temporaryOutputFilePath.str());
+        }
+
+        auto fileType = emitAssembly ? llvm::TargetMachine::CGFT_AssemblyFile : llvm::TargetMachine::CGFT_ObjectFile;
+
+        if (partitionCount == 1) {
+            emitMachineCode(*linkedModule, *targetMachine, temporaryOutputFilePaths[0], fileType);
+        } else {
+            emitMachineCodeInParallel(std::move(linkedModule), temporaryOutputFilePaths, fileType,
+                                      [&] { return createTargetMachine(cpu, features, relocModel, optimizationLevel); });
+        }
+
+        if (compileOnly || emitAssembly) {
+            llvm::SmallString<128> outputFilePath = outputDirectory;
+            llvm::sys::path::append(outputFilePath, llvm::Twine("output.") + outputFileExtension);
+            renameFile(temporaryOutputFilePaths[0], outputFilePath);
+            return 0;
+        }
+
+        objectFilePaths = temporaryOutputFilePaths;
     }
 
     // Link the output.
@@ -281,10 +1036,11 @@ static int buildExecutable(llvm::ArrayRef<std::string> files, const PackageManif
     llvm::SmallString<128> temporaryExecutablePath;
     llvm::sys::fs::createUniquePath(msvc ? "delta-%%%%%%%%.exe" : "delta-%%%%%%%%.out", temporaryExecutablePath, true);
 
-    std::vector<const char*> ccArgs = {
-        msvc ? ccPath.c_str() : argv0,
-        temporaryOutputFilePath.c_str(),
-    };
+    std::vector<const char*> ccArgs = {msvc ? ccPath.c_str() : argv0};
+
+    for (auto& objectFilePath : objectFilePaths) {
+        ccArgs.push_back(objectFilePath.c_str());
+    }
 
     ccArgs.push_back(msvc ? "-Fe:" : "-o");
     ccArgs.push_back(temporaryExecutablePath.c_str());
@@ -293,6 +1049,10 @@ static int buildExecutable(llvm::ArrayRef<std::string> files, const PackageManif
         ccArgs.push_back(cflag.c_str());
     }
 
+    if (isProfileGenerationEnabled()) {
+        ccArgs.push_back("-fprofile-instr-generate");
+    }
+
     if (msvc) {
         ccArgs.push_back("-link");
         ccArgs.push_back("-DEBUG");
@@ -302,14 +1062,25 @@ static int buildExecutable(llvm::ArrayRef<std::string> files, const PackageManif
     }
 
     std::vector<llvm::StringRef> ccArgStringRefs(ccArgs.begin(), ccArgs.end());
-    int ccExitStatus = msvc ? llvm::sys::ExecuteAndWait(ccArgs[0], ccArgStringRefs) : invokeClang(ccArgs);
-    llvm::sys::fs::remove(temporaryOutputFilePath);
+    int ccExitStatus;
+    {
+        llvm::TimeTraceScope timeScope("Link executable", llvm::StringRef(""));
+        PhaseStatistics phaseStatistics("link-executable");
+        ccExitStatus = msvc ? llvm::sys::ExecuteAndWait(ccArgs[0], ccArgStringRefs) : invokeClang(ccArgs, integratedLinker);
+    }
+    for (auto& temporaryOutputFilePath : temporaryOutputFilePaths) {
+        llvm::sys::fs::remove(temporaryOutputFilePath);
+    }
     if (ccExitStatus != 0) return ccExitStatus;
 
     if (run) {
         std::string command = (temporaryExecutablePath + " 2>&1").str();
         std::string output;
-        int executableExitStatus = exec(command.c_str(), output);
+        int executableExitStatus;
+        {
+            llvm::TimeTraceScope timeScope("Run", llvm::StringRef(""));
+            executableExitStatus = exec(command.c_str(), output);
+        }
         llvm::outs() << output;
         llvm::sys::fs::remove(temporaryExecutablePath);
 
@@ -357,21 +1128,102 @@ static int buildExecutable(llvm::ArrayRef<std::string> files, const PackageManif
     return 0;
 }
 
+static int buildExecutable(llvm::ArrayRef<std::string> files, const PackageManifest* manifest, const char* argv0,
+                           llvm::StringRef outputDirectory, std::string outputFileName) {
+    int exitStatus;
+    auto job = runFrontend(files, manifest, argv0, outputDirectory, std::move(outputFileName), exitStatus);
+    if (!job) return exitStatus;
+    return runBackend(*job);
+}
+
+static int buildPrecompiledStdlib(const char* argv0) {
+    if (specifiedOutputFileName.empty()) {
+        ABORT("no output file specified for the precompiled standard library");
+    }
+
+    auto options = getCompileOptions({});
+    auto key = getPrecompiledStdlibKey(options, argv0);
+    if (key.empty()) ABORT("couldn't read the standard library source files");
+
+    // Typechecking an empty module imports and typechecks the standard library.
+    Module module("main");
+    Typechecker typechecker(options);
+    typechecker.typecheckModule(module, nullptr);
+    if (errors) return 1;
+
+    llvm::LLVMContext context;
+    IRGenerator irGenerator(context);
+    auto& stdlibModule = irGenerator.codegenModule(*Module::getStdlibModule());
+    auto* keyMetadata = stdlibModule.getOrInsertNamedMetadata(precompiledStdlibKeyName);
+    keyMetadata->addOperand(llvm::MDNode::get(context, llvm::MDString::get(context, key)));
+    emitLLVMBitcode(stdlibModule, specifiedOutputFileName);
+    return 0;
+}
+
 static int buildPackage(llvm::StringRef packageRoot, const char* argv0) {
     auto manifestPath = (packageRoot + "/" + PackageManifest::manifestFileName).str();
     PackageManifest manifest(packageRoot);
     fetchDependencies(packageRoot);
+    auto targetRootDirs = manifest.getTargetRootDirectories();
+
+    // With multiple threads, each target is compiled and linked on the thread pool in its own compilation context, so
+    // that the frontends of the targets run concurrently too. The targets then don't share the imported modules, so
+    // each one parses and typechecks its own copy of the standard library and other dependencies. Diagnostics are
+    // collected per target and printed in the order of the targets. Each backend uses a single thread for code
+    // generation. Without a thread pool, the targets are built one at a time and share the imported modules.
+    std::unique_ptr<llvm::ThreadPool> threadPool;
+    if (build && targetRootDirs.size() > 1 && getCodegenThreadCount() > 1) {
+        threadPool = llvm::make_unique<llvm::ThreadPool>(getCodegenThreadCount());
+    }
+
+    std::vector<std::unique_ptr<CompilationContext>> contexts;
+    std::vector<DiagnosticBuffer> diagnostics(targetRootDirs.size());
+    std::vector<int> exitStatuses(targetRootDirs.size(), 0);
 
-    for (auto& targetRootDir : manifest.getTargetRootDirectories()) {
+    for (size_t i = 0; i < targetRootDirs.size(); ++i) {
         llvm::StringRef outputFileName;
         if (manifest.isMultiTarget() || manifest.getPackageName().empty()) {
-            outputFileName = llvm::sys::path::filename(targetRootDir);
+            outputFileName = llvm::sys::path::filename(targetRootDirs[i]);
         } else {
             outputFileName = manifest.getPackageName();
         }
-        auto sourceFiles = getSourceFiles(targetRootDir, manifestPath);
+        auto sourceFiles = getSourceFiles(targetRootDirs[i], manifestPath);
         // TODO: Add support for library packages.
-        int exitStatus = buildExecutable(sourceFiles, &manifest, argv0, manifest.getOutputDirectory(), outputFileName);
+
+        if (!threadPool) {
+            int exitStatus = buildExecutable(sourceFiles, &manifest, argv0, manifest.getOutputDirectory(), outputFileName);
+            if (exitStatus != 0) return exitStatus;
+            continue;
+        }
+
+        // Kept alive until the diagnostics have been printed, because their source locations point into the context.
+        contexts.push_back(llvm::make_unique<CompilationContext>());
+
+        threadPool->async([&, i, context = contexts.back().get(), sourceFiles = std::move(sourceFiles),
+                           outputFileName = outputFileName.str()] {
+            CompilationContextScope contextScope(*context);
+            std::unique_ptr<BackendJob> job;
+
+            {
+                DiagnosticBufferScope diagnosticScope(diagnostics[i]);
+                job = runFrontend(sourceFiles, &manifest, argv0, manifest.getOutputDirectory(), outputFileName, exitStatuses[i]);
+            }
+
+            if (job) {
+                job->codegenThreadCount = 1;
+                exitStatuses[i] = runBackend(*job);
+            }
+        });
+    }
+
+    if (!threadPool) return 0;
+    threadPool->wait();
+
+    for (auto& targetDiagnostics : diagnostics) {
+        targetDiagnostics.flush();
+    }
+
+    for (int exitStatus : exitStatuses) {
         if (exitStatus != 0) return exitStatus;
     }
 
@@ -385,21 +1237,226 @@ static void addPlatformDefines() {
 #endif
 }
 
-int main(int argc, const char** argv) {
-    llvm::InitLLVM x(argc, argv);
-    cl::ParseCommandLineOptions(argc, argv, "Delta compiler\n");
-    addPlatformDefines();
+static int runCompiler(const char* argv0) {
+    if (timeTrace) {
+        llvm::timeTraceProfilerInitialize(timeTraceGranularity);
+    }
 
-    if (!inputs.empty()) {
-        return buildExecutable(inputs, nullptr, argv[0], ".", "");
-    } else if (build || run) {
+    if (printStats.getNumOccurrences() > 0) {
+        if (printStats != "" && printStats != "text" && printStats != "json") {
+            ABORT("invalid -print-stats format '" << printStats << "', expected 'text' or 'json'");
+        }
+        collectStatistics = true;
+    }
+
+    if (isProfileGenerationEnabled() && !profileUse.empty()) {
+        ABORT("-fprofile-generate and -fprofile-use can't be used together");
+    }
+
+    if (!profileUse.empty() && !llvm::sys::fs::exists(profileUse)) {
+        ABORT("profile file '" << profileUse << "' not found");
+    }
+
+    int exitStatus = 0;
+
+    if (emitPrecompiledStdlib) {
+        exitStatus = buildPrecompiledStdlib(argv0);
+    } else if (!inputs.empty()) {
+        exitStatus = buildExecutable(inputs, nullptr, argv0, ".", "");
+    } else if (build || run || bench) {
         llvm::SmallString<128> currentPath;
         if (auto error = llvm::sys::fs::current_path(currentPath)) {
             ABORT(error.message());
         }
-        return buildPackage(currentPath, argv[0]);
+        exitStatus = buildPackage(currentPath, argv0);
     } else {
         cl::PrintHelpMessage();
-        return 0;
     }
+
+    if (llvm::timeTraceProfilerEnabled()) {
+        std::error_code error;
+        llvm::raw_fd_ostream file(timeTraceFile, error, llvm::sys::fs::F_Text);
+        if (error) ABORT(error.message());
+        llvm::timeTraceProfilerWrite(file);
+        llvm::timeTraceProfilerCleanup();
+    }
+
+    if (collectStatistics) {
+        if (printStats == "json") {
+            printStatisticsAsJSON(llvm::errs());
+        } else {
+            printStatistics(llvm::errs());
+        }
+    }
+
+    return exitStatus;
+}
+
+static const char serverSocketEnvVar[] = "DELTA_SERVER_SOCKET";
+
+static std::string getServerSocketPath() {
+    if (!serverSocketPath.empty()) return serverSocketPath;
+    if (auto path = llvm::sys::Process::GetEnv(serverSocketEnvVar)) return *path;
+    return getDefaultServerSocketPath();
+}
+
+/// Returns a string identifying the options and environment variables that affect how imported modules are
+/// loaded. The compile server's loaded modules are only used by requests with the same options.
+static std::string getImportOptionsKey() {
+    std::string key;
+
+    for (auto* list : {&defines, &importSearchPaths, &frameworkSearchPaths, &cflags}) {
+        for (auto& value : *list) {
+            key += value;
+            key += ';';
+        }
+        key += '\n';
+    }
+
+    for (auto* name : {"CPATH", "C_INCLUDE_PATH", "INCLUDE"}) {
+        if (auto value = llvm::sys::Process::GetEnv(name)) key += *value;
+        key += '\n';
+    }
+
+    key += noPrecompiledStdlib ? "1" : "0";
+    key += precompiledStdlibPath;
+    return key;
+}
+
+/// A file that a module loaded by the compile server was read from.
+struct ServerModuleFile {
+    std::string path;
+    llvm::sys::TimePoint<> modificationTime;
+    std::string hash;
+};
+
+static CompileOptions serverCompileOptions;
+static std::string serverImportOptionsKey;
+static std::vector<std::string> serverHeaderNames;
+static std::vector<ServerModuleFile> serverModuleFiles;
+
+static void addServerModuleFile(llvm::StringRef path) {
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(path, status)) return;
+    serverModuleFiles.push_back({path.str(), status.getLastModificationTime(), getFileHash(path)});
+}
+
+/// Imports a C header into the compile server, so that later requests importing it don't need to parse it.
+static void importServerHeader(llvm::StringRef headerName) {
+    static SourceFile importer("");
+    if (!importCHeader(importer, headerName, serverCompileOptions, SourceLocation())) return;
+
+    serverHeaderNames.push_back(headerName.str());
+    for (auto& headerFile : Module::getAllImportedModulesMap()[headerName]->getHeaderFiles()) {
+        addServerModuleFile(headerFile);
+    }
+}
+
+/// (Re)loads the modules kept in memory by the compile server: the standard library, and the C headers imported
+/// by earlier requests. The previously loaded modules are leaked, because other modules may still refer to them.
+static void loadServerModules() {
+    discardImportedModules();
+    serverModuleFiles.clear();
+
+    Module module("main");
+    Typechecker typechecker(serverCompileOptions);
+    typechecker.typecheckModule(module, nullptr);
+
+    for (auto& sourceFile : Module::getStdlibModule()->getSourceFiles()) {
+        addServerModuleFile(sourceFile.getFilePath());
+    }
+
+    auto headerNames = std::move(serverHeaderNames);
+    serverHeaderNames.clear();
+
+    for (auto& headerName : headerNames) {
+        importServerHeader(headerName);
+    }
+
+    // Errors in imports that fail here are reported again to the requests that import them.
+    errors = 0;
+}
+
+/// Returns true if the files of the compile server's loaded modules have been modified since they were loaded.
+static bool serverModulesAreOutOfDate() {
+    for (auto& file : serverModuleFiles) {
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(file.path, status)) return true;
+        if (status.getLastModificationTime() == file.modificationTime) continue;
+        if (getFileHash(file.path) != file.hash) return true;
+        file.modificationTime = status.getLastModificationTime();
+    }
+
+    return false;
+}
+
+[[noreturn]] static void runServer(const char* argv0) {
+    serverImportOptionsKey = getImportOptionsKey();
+    serverCompileOptions = getCompileOptions({});
+
+    if (!noPrecompiledStdlib) {
+        llvm::LLVMContext context;
+        serverCompileOptions.usePrecompiledStdlib = loadPrecompiledStdlib(context, serverCompileOptions, argv0) != nullptr;
+    }
+
+    loadServerModules();
+
+    CompileServerCallbacks callbacks;
+
+    callbacks.prepare = [] {
+        if (serverModulesAreOutOfDate()) loadServerModules();
+    };
+
+    callbacks.compile = [](llvm::ArrayRef<const char*> args, llvm::raw_ostream& report) {
+        cl::ResetAllOptionOccurrences();
+        cl::ParseCommandLineOptions(int(args.size()), args.data(), "Delta compiler\n");
+        addPlatformDefines();
+
+        if (getImportOptionsKey() != serverImportOptionsKey) {
+            discardImportedModules();
+            return runCompiler(args[0]);
+        }
+
+        int exitStatus = runCompiler(args[0]);
+
+        for (auto& entry : Module::getAllImportedModulesMap()) {
+            if (entry.getKey().endswith(".h")) report << entry.getKey() << "\n";
+        }
+
+        return exitStatus;
+    };
+
+    callbacks.processReport = [](llvm::StringRef report) {
+        llvm::SmallVector<llvm::StringRef, 16> headerNames;
+        report.split(headerNames, '\n', -1, false);
+
+        for (auto headerName : headerNames) {
+            if (!Module::getAllImportedModulesMap().count(headerName)) {
+                importServerHeader(headerName);
+            }
+        }
+
+        errors = 0;
+    };
+
+    runCompileServer(getServerSocketPath(), callbacks);
+}
+
+int main(int argc, const char** argv) {
+    llvm::InitLLVM x(argc, argv);
+
+    // Forward the invocation to the compile server if one is configured, or compile in this process if it's not running.
+    if (llvm::sys::Process::GetEnv(serverSocketEnvVar) && !(argc > 1 && llvm::StringRef(argv[1]) == "serve")) {
+        int exitStatus;
+        if (sendCompileRequest(*llvm::sys::Process::GetEnv(serverSocketEnvVar), llvm::makeArrayRef(argv, argc), exitStatus)) {
+            return exitStatus;
+        }
+    }
+
+    cl::ParseCommandLineOptions(argc, argv, "Delta compiler\n");
+    addPlatformDefines();
+
+    if (serve) runServer(argv[0]);
+
+    return runCompiler(argv[0]);
 }
@@ -5,12 +5,20 @@
 
 namespace delta {
 
+enum class OptimizationLevel { O0, O1, O2, O3, Os };
+enum class LTOMode { None, Full, Thin };
+
 struct CompileOptions {
     std::vector<std::string> disabledWarnings;
     std::vector<std::string> importSearchPaths;
     std::vector<std::string> frameworkSearchPaths;
     std::vector<std::string> defines;
     std::vector<std::string> cflags;
+    bool usePrecompiledStdlib = false;
+    /// If false, the bodies of functions in imported modules are only typechecked once they're referenced.
+    bool typecheckAllFunctionBodies = false;
+    /// If greater than 1, the bodies of the main module's top-level functions are typechecked concurrently.
+    unsigned typecheckThreadCount = 1;
 };
 
 } // namespace delta
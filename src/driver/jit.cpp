@@ -0,0 +1,113 @@
+#include "jit.h"
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#pragma warning(push, 0)
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#pragma warning(pop)
+#include "../support/utility.h"
+
+using namespace delta;
+
+using MainFunction = int (*)(int, char**);
+
+static int callMain(MainFunction main) {
+    char programName[] = "delta-run";
+    char* args[] = {programName, nullptr};
+    return main(1, args);
+}
+
+#ifndef _WIN32
+/// Runs the program in a forked child process, so that crashes and calls to exit() in the program don't take down
+/// the compiler, and the exit status matches the one obtained when running a linked executable.
+static int runInChildProcess(MainFunction main) {
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::fflush(nullptr);
+
+    pid_t pid = fork();
+    if (pid == -1) ABORT("failed to fork process for running the program");
+
+    if (pid == 0) {
+        // Merge stderr into stdout like the AOT path does, and let crashes in the program terminate it normally
+        // instead of invoking the compiler's crash handlers.
+        dup2(STDOUT_FILENO, STDERR_FILENO);
+        for (int signal : {SIGABRT, SIGBUS, SIGFPE, SIGILL, SIGSEGV, SIGTRAP}) {
+            std::signal(signal, SIG_DFL);
+        }
+        int exitStatus = callMain(main);
+        std::fflush(nullptr);
+        _exit(exitStatus);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1) ABORT("failed to wait for the program to finish");
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+#endif
+
+std::unique_ptr<llvm::orc::LLJIT> delta::createJIT(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context,
+                                                   const llvm::TargetMachine& targetMachine,
+                                                   llvm::ArrayRef<std::pair<llvm::StringRef, void*>> symbolOverrides) {
+    llvm::orc::JITTargetMachineBuilder targetMachineBuilder(targetMachine.getTargetTriple());
+    targetMachineBuilder.setCPU(targetMachine.getTargetCPU());
+    targetMachineBuilder.getFeatures() = llvm::SubtargetFeatures(targetMachine.getTargetFeatureString());
+    targetMachineBuilder.setCodeGenOptLevel(targetMachine.getOptLevel());
+
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(targetMachineBuilder)).create();
+    if (!jit) ABORT(llvm::toString(jit.takeError()));
+
+    // Symbols defined in the JITDylib take precedence over the ones found by its generator.
+    if (!symbolOverrides.empty()) {
+        llvm::orc::MangleAndInterner mangle((*jit)->getExecutionSession(), (*jit)->getDataLayout());
+        llvm::orc::SymbolMap symbols;
+        for (auto& symbolOverride : symbolOverrides) {
+            symbols[mangle(symbolOverride.first)] =
+                llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(symbolOverride.second), llvm::JITSymbolFlags::Exported);
+        }
+        if (auto error = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+            ABORT(llvm::toString(std::move(error)));
+        }
+    }
+
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator) ABORT(llvm::toString(generator.takeError()));
+    (*jit)->getMainJITDylib().setGenerator(std::move(*generator));
+
+    llvm::orc::ThreadSafeModule threadSafeModule(std::move(module), llvm::orc::ThreadSafeContext(std::move(context)));
+    if (auto error = (*jit)->addIRModule(std::move(threadSafeModule))) {
+        ABORT(llvm::toString(std::move(error)));
+    }
+
+    return std::move(*jit);
+}
+
+void* delta::lookupJITSymbol(llvm::orc::LLJIT& jit, llvm::StringRef name) {
+    auto symbol = jit.lookup(name);
+    if (!symbol) ABORT(llvm::toString(symbol.takeError()));
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(symbol->getAddress()));
+}
+
+int delta::runJIT(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context,
+                  const llvm::TargetMachine& targetMachine) {
+    auto jit = createJIT(std::move(module), std::move(context), targetMachine);
+    auto main = reinterpret_cast<MainFunction>(lookupJITSymbol(*jit, "main"));
+
+#ifdef _WIN32
+    return callMain(main);
+#else
+    return runInChildProcess(main);
+#endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#pragma warning(push, 0)
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#pragma warning(pop)
+
+namespace llvm {
+class LLVMContext;
+class Module;
+class TargetMachine;
+namespace orc {
+class LLJIT;
+}
+} // namespace llvm
+
+namespace delta {
+
+/// Creates an ORC JIT containing the given module. C library symbols are resolved from the host process, except
+/// for the ones in symbolOverrides, which are resolved to the given addresses.
+std::unique_ptr<llvm::orc::LLJIT> createJIT(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context,
+                                            const llvm::TargetMachine& targetMachine,
+                                            llvm::ArrayRef<std::pair<llvm::StringRef, void*>> symbolOverrides = {});
+
+/// Compiles the given symbol if needed and returns its address.
+void* lookupJITSymbol(llvm::orc::LLJIT& jit, llvm::StringRef name);
+
+/// Compiles the given module in-process using ORC and runs its main function. C library symbols are resolved
+/// from the host process. Returns the exit status of the program.
+int runJIT(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context, const llvm::TargetMachine& targetMachine);
+
+} // namespace delta
@@ -0,0 +1,135 @@
+#include "lto.h"
+#include <algorithm>
+#pragma warning(push, 0)
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Module.h>
+#include <llvm/LTO/Caching.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#pragma warning(pop)
+#include "../support/stats.h"
+#include "../support/utility.h"
+
+using namespace delta;
+
+void delta::writeLTOBitcode(const llvm::Module& module, llvm::raw_ostream& stream, LTOMode ltoMode) {
+    if (ltoMode == LTOMode::Thin) {
+        auto summary = llvm::buildModuleSummaryIndex(module, nullptr, nullptr);
+        llvm::WriteBitcodeToFile(module, stream, false, &summary, true);
+    } else {
+        llvm::WriteBitcodeToFile(module, stream);
+    }
+}
+
+static llvm::lto::Config createLTOConfig(const llvm::TargetMachine& targetMachine, unsigned optimizationLevel) {
+    llvm::lto::Config config;
+    config.CPU = targetMachine.getTargetCPU();
+    config.MAttrs = llvm::SubtargetFeatures(targetMachine.getTargetFeatureString()).getFeatures();
+    config.Options = targetMachine.Options;
+    config.RelocModel = targetMachine.getRelocationModel();
+    config.CGOptLevel = targetMachine.getOptLevel();
+    config.OptLevel = optimizationLevel;
+    return config;
+}
+
+/// Picks the definition that the linker would use for each symbol: the first strong definition, or the first weak
+/// definition if there's no strong one. Returns a map from symbol names to the index of the prevailing input file.
+static llvm::StringMap<size_t> getPrevailingDefinitions(llvm::ArrayRef<std::unique_ptr<llvm::lto::InputFile>> inputFiles) {
+    llvm::StringMap<size_t> prevailingDefinitions;
+    llvm::StringMap<bool> prevailingDefinitionIsWeak;
+
+    for (size_t i = 0; i < inputFiles.size(); ++i) {
+        for (auto& symbol : inputFiles[i]->symbols()) {
+            if (symbol.isUndefined()) continue;
+
+            auto isWeak = prevailingDefinitionIsWeak.find(symbol.getName());
+            if (isWeak == prevailingDefinitionIsWeak.end() || (isWeak->second && !symbol.isWeak())) {
+                prevailingDefinitions[symbol.getName()] = i;
+                prevailingDefinitionIsWeak[symbol.getName()] = symbol.isWeak();
+            }
+        }
+    }
+
+    return prevailingDefinitions;
+}
+
+std::vector<std::string> delta::compileWithLTO(std::vector<std::unique_ptr<llvm::Module>> modules, LTOMode ltoMode,
+                                               const llvm::TargetMachine& targetMachine, unsigned optimizationLevel, unsigned threadCount,
+                                               bool exportAllSymbols, llvm::StringRef objectFileExtension) {
+    llvm::TimeTraceScope timeScope("LTO", llvm::StringRef(ltoMode == LTOMode::Thin ? "thin" : "full"));
+    PhaseStatistics phaseStatistics("lto");
+
+    // Module identifiers aren't necessarily unique (e.g. the precompiled standard library and the generated
+    // standard library module are both named 'std'), but ThinLTO uses them to find the modules to import from.
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+    std::vector<std::unique_ptr<llvm::lto::InputFile>> inputFiles;
+
+    for (size_t i = 0; i < modules.size(); ++i) {
+        llvm::SmallString<0> bitcode;
+        llvm::raw_svector_ostream bitcodeStream(bitcode);
+        writeLTOBitcode(*modules[i], bitcodeStream, ltoMode);
+        auto identifier = (llvm::Twine(i) + ":" + modules[i]->getModuleIdentifier()).str();
+        modules[i].reset();
+
+        buffers.push_back(llvm::MemoryBuffer::getMemBufferCopy(bitcode, identifier));
+        auto inputFile = llvm::lto::InputFile::create(buffers.back()->getMemBufferRef());
+        if (!inputFile) ABORT("couldn't read LTO input '" << identifier << "': " << llvm::toString(inputFile.takeError()));
+        inputFiles.push_back(std::move(*inputFile));
+    }
+
+    auto prevailingDefinitions = getPrevailingDefinitions(inputFiles);
+    auto thinBackend = ltoMode == LTOMode::Thin ? llvm::lto::createInProcessThinBackend(threadCount) : nullptr;
+    llvm::lto::LTO lto(createLTOConfig(targetMachine, optimizationLevel), std::move(thinBackend), threadCount);
+
+    for (size_t i = 0; i < inputFiles.size(); ++i) {
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+
+        for (auto& symbol : inputFiles[i]->symbols()) {
+            llvm::lto::SymbolResolution resolution;
+            auto prevailingDefinition = prevailingDefinitions.find(symbol.getName());
+            resolution.Prevailing = !symbol.isUndefined() && prevailingDefinition->second == i;
+            resolution.VisibleToRegularObj = exportAllSymbols || prevailingDefinition == prevailingDefinitions.end() ||
+                                             symbol.getIRName() == "main";
+            resolutions.push_back(resolution);
+        }
+
+        if (auto error = lto.add(std::move(inputFiles[i]), resolutions)) {
+            ABORT("LTO failed: " << llvm::toString(std::move(error)));
+        }
+    }
+
+    std::vector<std::string> objectFilePaths(lto.getMaxTasks());
+
+    // Called by the ThinLTO backend from multiple threads, each with a different task.
+    auto addStream = [&](unsigned task) {
+        llvm::SmallString<128> objectFilePath;
+        if (auto error = llvm::sys::fs::createTemporaryFile("delta-lto", objectFileExtension, objectFilePath)) {
+            ABORT(error.message());
+        }
+        objectFilePaths[task] = objectFilePath.str();
+
+        std::error_code error;
+        auto file = llvm::make_unique<llvm::raw_fd_ostream>(objectFilePath, error, llvm::sys::fs::F_None);
+        if (error) ABORT(error.message());
+        return llvm::make_unique<llvm::lto::NativeObjectStream>(std::move(file));
+    };
+
+    if (auto error = lto.run(addStream)) {
+        ABORT("LTO failed: " << llvm::toString(std::move(error)));
+    }
+
+    // Tasks for modules that were merged into the full LTO module or had nothing left to compile don't produce
+    // an object file.
+    objectFilePaths.erase(std::remove(objectFilePaths.begin(), objectFilePaths.end(), ""), objectFilePaths.end());
+    return objectFilePaths;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#pragma warning(push, 0)
+#include <llvm/ADT/StringRef.h>
+#pragma warning(pop)
+#include "driver.h"
+
+namespace llvm {
+class Module;
+class raw_ostream;
+class TargetMachine;
+} // namespace llvm
+
+namespace delta {
+
+/// Writes the given module as bitcode, including a module summary in ThinLTO mode so that the output can be used
+/// as an input for ThinLTO by Delta, Clang, or lld.
+void writeLTOBitcode(const llvm::Module& module, llvm::raw_ostream& stream, LTOMode ltoMode);
+
+/// Optimizes the given modules together with LLVM's LTO backend and compiles them to object files, returning the
+/// paths of the temporary object files. Full LTO merges the modules into one before optimizing, while ThinLTO
+/// optimizes the modules in parallel, importing functions from the other modules based on their summaries. Unless
+/// exportAllSymbols is set, only main is assumed to be referenced from outside the modules, so that unused
+/// definitions can be removed and the rest can be inlined without keeping an out-of-line copy.
+std::vector<std::string> compileWithLTO(std::vector<std::unique_ptr<llvm::Module>> modules, LTOMode ltoMode,
+                                        const llvm::TargetMachine& targetMachine, unsigned optimizationLevel, unsigned threadCount,
+                                        bool exportAllSymbols, llvm::StringRef objectFileExtension);
+
+} // namespace delta
@@ -0,0 +1,424 @@
+#include "server.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#pragma warning(push, 0)
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#pragma warning(pop)
+#include "../support/utility.h"
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
+using namespace delta;
+
+#ifndef _WIN32
+
+// A compile request consists of the client's stdin, stdout, and stderr file descriptors, sent as ancillary data,
+// followed by the command-line arguments, the working directory, and the environment variables as length-prefixed
+// strings. The server responds with the exit status of the compilation.
+
+static const int forwardedFileDescriptorCount = 3;
+
+static bool writeAll(int fd, const void* data, size_t size) {
+    auto* bytes = static_cast<const char*>(data);
+
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size) {
+    auto* bytes = static_cast<char*>(data);
+
+    while (size > 0) {
+        ssize_t bytesRead = read(fd, bytes, size);
+        if (bytesRead == -1 && errno == EINTR) continue;
+        if (bytesRead <= 0) return false;
+        bytes += bytesRead;
+        size -= bytesRead;
+    }
+
+    return true;
+}
+
+static bool writeStrings(int fd, const std::vector<std::string>& strings) {
+    uint32_t count = uint32_t(strings.size());
+    if (!writeAll(fd, &count, sizeof(count))) return false;
+
+    for (auto& string : strings) {
+        uint32_t size = uint32_t(string.size());
+        if (!writeAll(fd, &size, sizeof(size)) || !writeAll(fd, string.data(), size)) return false;
+    }
+
+    return true;
+}
+
+static bool readStrings(int fd, std::vector<std::string>& strings) {
+    uint32_t count;
+    if (!readAll(fd, &count, sizeof(count))) return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t size;
+        if (!readAll(fd, &size, sizeof(size))) return false;
+        std::string string(size, '\0');
+        if (!readAll(fd, &string[0], size)) return false;
+        strings.push_back(std::move(string));
+    }
+
+    return true;
+}
+
+static bool sendFileDescriptors(int socket, const int (&fds)[forwardedFileDescriptorCount]) {
+    char byte = 0;
+    iovec data = {&byte, 1};
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    return sendmsg(socket, &message, 0) == 1;
+}
+
+static bool receiveFileDescriptors(int socket, int (&fds)[forwardedFileDescriptorCount]) {
+    char byte;
+    iovec data = {&byte, 1};
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(socket, &message, 0) != 1) return false;
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(fds))) return false;
+    std::memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    return true;
+}
+
+static bool getSocketAddress(llvm::StringRef socketPath, sockaddr_un& address) {
+    address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, socketPath.data(), socketPath.size());
+    return true;
+}
+
+/// Returns true if the process connected to the other end of the given socket runs as the same user as this process.
+static bool isPeerSameUser(int socket) {
+#ifdef __linux__
+    ucred credentials;
+    socklen_t size = sizeof(credentials);
+    if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == -1) return false;
+    return credentials.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(socket, &uid, &gid) == -1) return false;
+    return uid == getuid();
+#endif
+}
+
+static int connectToServer(llvm::StringRef socketPath) {
+    sockaddr_un address;
+    if (!getSocketAddress(socketPath, address)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool delta::sendCompileRequest(llvm::StringRef socketPath, llvm::ArrayRef<const char*> args, int& exitStatus) {
+    int fd = connectToServer(socketPath);
+    if (fd == -1) return false;
+
+    llvm::SmallString<128> currentPath;
+    if (auto error = llvm::sys::fs::current_path(currentPath)) {
+        close(fd);
+        return false;
+    }
+
+    std::vector<std::string> environment;
+    for (char** variable = environ; *variable; ++variable) {
+        environment.push_back(*variable);
+    }
+
+    int fds[forwardedFileDescriptorCount] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    std::vector<std::string> argStrings(args.begin(), args.end());
+
+    // Once the request has been sent, the server may already have written to our stdout and stderr, so from here
+    // on the request must not be retried by compiling locally.
+    if (!sendFileDescriptors(fd, fds) || !writeStrings(fd, argStrings) || !writeStrings(fd, {currentPath.str().str()}) ||
+        !writeStrings(fd, environment)) {
+        close(fd);
+        return false;
+    }
+
+    int32_t status;
+    if (!readAll(fd, &status, sizeof(status))) {
+        llvm::errs() << "error: compile server closed the connection without responding\n";
+        status = 1;
+    }
+
+    close(fd);
+    exitStatus = status;
+    return true;
+}
+
+namespace {
+
+/// A compile request that is being processed in a child process.
+struct CompileJob {
+    pid_t pid;
+    int clientSocket;
+    int reportPipe;
+    std::string report;
+};
+
+} // namespace
+
+[[noreturn]] static void runCompileJob(int listenSocket, int clientSocket, int reportPipe, const int (&fds)[forwardedFileDescriptorCount],
+                                       const std::vector<std::string>& args, llvm::StringRef currentPath,
+                                       std::vector<std::string>& environment, const CompileServerCallbacks& callbacks) {
+    close(listenSocket);
+    close(clientSocket);
+
+    for (int i = 0; i < forwardedFileDescriptorCount; ++i) {
+        if (fds[i] == i) continue;
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+
+    std::signal(SIGPIPE, SIG_DFL);
+
+    if (auto error = llvm::sys::fs::set_current_path(currentPath)) {
+        llvm::errs() << "error: couldn't change to directory '" << currentPath << "': " << error.message() << "\n";
+        _exit(1);
+    }
+
+    // The strings are never freed, since this process exits after the compilation.
+    static std::vector<char*> environmentVariables;
+    for (auto& variable : environment) {
+        environmentVariables.push_back(&variable[0]);
+    }
+    environmentVariables.push_back(nullptr);
+    environ = environmentVariables.data();
+
+    auto argPointers = map(args, [](const std::string& arg) { return arg.c_str(); });
+
+    int exitStatus;
+    {
+        llvm::raw_fd_ostream report(reportPipe, true);
+        exitStatus = callbacks.compile(argPointers, report);
+    }
+
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::fflush(nullptr);
+    _exit(exitStatus);
+}
+
+static void startCompileJob(int listenSocket, int clientSocket, std::vector<CompileJob>& jobs, const CompileServerCallbacks& callbacks) {
+    int fds[forwardedFileDescriptorCount];
+    if (!receiveFileDescriptors(clientSocket, fds)) {
+        close(clientSocket);
+        return;
+    }
+
+    std::vector<std::string> args;
+    std::vector<std::string> currentPath;
+    std::vector<std::string> environment;
+    int reportPipe[2];
+
+    if (!readStrings(clientSocket, args) || args.empty() || !readStrings(clientSocket, currentPath) || currentPath.size() != 1 ||
+        !readStrings(clientSocket, environment) || pipe(reportPipe) == -1) {
+        for (int fd : fds) close(fd);
+        close(clientSocket);
+        return;
+    }
+
+    callbacks.prepare();
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::fflush(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(reportPipe[0]);
+        for (auto& job : jobs) {
+            close(job.clientSocket);
+            close(job.reportPipe);
+        }
+        runCompileJob(listenSocket, clientSocket, reportPipe[1], fds, args, currentPath[0], environment, callbacks);
+    }
+
+    for (int fd : fds) close(fd);
+    close(reportPipe[1]);
+
+    if (pid == -1) {
+        close(reportPipe[0]);
+        int32_t exitStatus = 1;
+        writeAll(clientSocket, &exitStatus, sizeof(exitStatus));
+        close(clientSocket);
+        return;
+    }
+
+    jobs.push_back({pid, clientSocket, reportPipe[0], ""});
+}
+
+static void finishCompileJob(CompileJob& job, const CompileServerCallbacks& callbacks) {
+    int status;
+    while (waitpid(job.pid, &status, 0) == -1) {
+        if (errno != EINTR) ABORT("failed to wait for compile job to finish");
+    }
+
+    int32_t exitStatus = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+    writeAll(job.clientSocket, &exitStatus, sizeof(exitStatus));
+    close(job.clientSocket);
+    close(job.reportPipe);
+    callbacks.processReport(job.report);
+}
+
+std::string delta::getDefaultServerSocketPath() {
+    llvm::SmallString<128> path;
+
+    // The runtime directory is private to the user. The temporary directory may be shared between users, so the
+    // socket name includes the user ID so that each user gets their own server.
+    if (auto runtimeDirectory = llvm::sys::Process::GetEnv("XDG_RUNTIME_DIR")) {
+        path = *runtimeDirectory;
+        llvm::sys::path::append(path, "delta-server.sock");
+    } else {
+        llvm::sys::path::system_temp_directory(false, path);
+        llvm::sys::path::append(path, "delta-server-" + std::to_string(getuid()) + ".sock");
+    }
+
+    return path.str();
+}
+
+void delta::runCompileServer(llvm::StringRef socketPath, const CompileServerCallbacks& callbacks) {
+    int existingServer = connectToServer(socketPath);
+    if (existingServer != -1) {
+        close(existingServer);
+        ABORT("a compile server is already listening on '" << socketPath << "'");
+    }
+
+    sockaddr_un address;
+    if (!getSocketAddress(socketPath, address)) ABORT("socket path '" << socketPath << "' is too long");
+
+    // The socket file may have been left behind by a server that was killed.
+    llvm::sys::fs::remove(socketPath);
+
+    // Compile requests run code as the user running the server, so the socket file is created accessible only to
+    // that user. Connections from other users are also rejected below, in case the socket is in a shared directory.
+    int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t previousUmask = umask(S_IRWXG | S_IRWXO);
+    bool bound = listenSocket != -1 && bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != -1;
+    umask(previousUmask);
+
+    if (!bound || listen(listenSocket, SOMAXCONN) == -1) {
+        ABORT("couldn't listen on '" << socketPath << "': " << std::strerror(errno));
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<CompileJob> jobs;
+
+    while (true) {
+        std::vector<pollfd> pollFDs = {{listenSocket, POLLIN, 0}};
+        for (auto& job : jobs) {
+            pollFDs.push_back({job.reportPipe, POLLIN, 0});
+        }
+
+        if (poll(pollFDs.data(), pollFDs.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            ABORT("poll failed: " << std::strerror(errno));
+        }
+
+        // The child process closes its end of the report pipe when it exits.
+        for (size_t i = jobs.size(); i > 0; --i) {
+            if (pollFDs[i].revents == 0) continue;
+            auto& job = jobs[i - 1];
+            char buffer[4096];
+            ssize_t bytesRead = read(job.reportPipe, buffer, sizeof(buffer));
+
+            if (bytesRead > 0) {
+                job.report.append(buffer, bytesRead);
+            } else if (bytesRead == 0 || errno != EINTR) {
+                finishCompileJob(job, callbacks);
+                jobs.erase(jobs.begin() + (i - 1));
+            }
+        }
+
+        if (pollFDs[0].revents & POLLIN) {
+            int clientSocket = accept(listenSocket, nullptr, nullptr);
+            if (clientSocket != -1) {
+                if (isPeerSameUser(clientSocket)) {
+                    startCompileJob(listenSocket, clientSocket, jobs, callbacks);
+                } else {
+                    close(clientSocket);
+                }
+            }
+        }
+    }
+}
+
+#else
+
+std::string delta::getDefaultServerSocketPath() {
+    llvm::SmallString<128> path;
+    llvm::sys::path::system_temp_directory(false, path);
+    llvm::sys::path::append(path, "delta-server.sock");
+    return path.str();
+}
+
+void delta::runCompileServer(llvm::StringRef, const CompileServerCallbacks&) {
+    ABORT("the compile server is not supported on Windows");
+}
+
+bool delta::sendCompileRequest(llvm::StringRef, llvm::ArrayRef<const char*>, int&) {
+    return false;
+}
+
+#endif
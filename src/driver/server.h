@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#pragma warning(push, 0)
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#pragma warning(pop)
+
+namespace delta {
+
+struct CompileServerCallbacks {
+    /// Called in the server before each compile request is started, e.g. to reload modules that are out of date.
+    std::function<void()> prepare;
+    /// Called in the child process forked for a compile request, with the command-line arguments of the client.
+    /// Anything written to the report stream is passed to processReport when the child process has exited.
+    /// Returns the exit status to send back to the client.
+    std::function<int(llvm::ArrayRef<const char*> args, llvm::raw_ostream& report)> compile;
+    std::function<void(llvm::StringRef report)> processReport;
+};
+
+/// Returns the socket the compile server listens on if none is specified: delta-server.sock in $XDG_RUNTIME_DIR,
+/// or a socket named after the current user ID in the temporary directory.
+std::string getDefaultServerSocketPath();
+
+/// Listens for compile requests from delta clients on the given Unix domain socket until the process is killed.
+/// The socket is only accessible to the current user, and connections from processes of other users are rejected.
+/// Each request is compiled in a child process forked from the server, so that it starts out with everything the
+/// server has loaded into memory, with the client's working directory, environment, and standard streams.
+[[noreturn]] void runCompileServer(llvm::StringRef socketPath, const CompileServerCallbacks& callbacks);
+
+/// Sends the command-line arguments to the compile server listening on the given socket, and waits for it to
+/// finish compiling. Returns false if no server is listening on the socket.
+bool sendCompileRequest(llvm::StringRef socketPath, llvm::ArrayRef<const char*> args, int& exitStatus);
+
+} // namespace delta
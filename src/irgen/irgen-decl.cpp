@@ -3,12 +3,39 @@
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/SaveAndRestore.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
 #include "../ast/mangle.h"
 
 using namespace delta;
 
+/// Returns the LLVM module that the given function's body is to be generated into, if the function belongs to a
+/// module generated with skipUnreferencedFunctions. Generic instantiations are generated into the module that
+/// references them first instead, like for other modules.
+llvm::Module* IRGenerator::getOnDemandModule(const FunctionDecl& decl) const {
+    if (!decl.getGenericArgs().empty()) return nullptr;
+    if (auto* typeDecl = decl.getTypeDecl()) {
+        if (!typeDecl->getGenericArgs().empty()) return nullptr;
+    }
+
+    auto it = onDemandModules.find(decl.getModule());
+    return it != onDemandModules.end() ? it->second : nullptr;
+}
+
 llvm::Function* IRGenerator::getFunctionProto(const FunctionDecl& decl) {
+    auto* onDemandModule = getOnDemandModule(decl);
+
+    // Create the definition in the module that the function belongs to, and a declaration in this one.
+    if (onDemandModule && onDemandModule != module) {
+        llvm::Function* definition;
+        {
+            llvm::SaveAndRestore setModule(module, onDemandModule);
+            definition = getFunctionProto(decl);
+        }
+        if (auto* function = module->getFunction(definition->getName())) return function;
+        return llvm::Function::Create(definition->getFunctionType(), llvm::Function::ExternalLinkage, definition->getName(), &*module);
+    }
+
     auto mangled = mangleFunctionDecl(decl);
     if (auto* function = module->getFunction(mangled)) return function;
 
@@ -48,6 +75,8 @@ llvm::Function* IRGenerator::getFunctionProto(const FunctionDecl& decl) {
 }
 
 void IRGenerator::codegenFunctionBody(const FunctionDecl& decl, llvm::Function& function) {
+    llvm::TimeTraceScope timeScope("Codegen function", [&] { return decl.getQualifiedName(); });
+    generatedFunctions.insert(&decl);
     builder.SetInsertPoint(llvm::BasicBlock::Create(ctx, "", &function));
     beginScope();
     auto arg = function.arg_begin();
@@ -84,7 +113,9 @@ void IRGenerator::codegenFunctionBody(const FunctionDecl& decl, llvm::Function&
 void IRGenerator::codegenFunctionDecl(const FunctionDecl& decl) {
     llvm::Function* function = getFunctionProto(decl);
 
-    if (!decl.isExtern() && function->empty()) {
+    // The bodies of functions belonging to other modules are generated by codegenReferencedFunctionBodies.
+    auto* onDemandModule = getOnDemandModule(decl);
+    if ((!decl.isExtern() || decl.hasBody()) && !decl.hasPrecompiledBody() && function->empty() && (!onDemandModule || onDemandModule == module)) {
         codegenFunctionBody(decl, *function);
     }
 
@@ -104,11 +135,11 @@ std::vector<llvm::Type*> IRGenerator::getFieldTypes(const TypeDecl& decl) {
 
 llvm::StructType* IRGenerator::codegenTypeDecl(const TypeDecl& d) {
     // TODO: Figure out a better way to handle the use of 'This' in interface field types.
-    const TypeDecl& decl = d.isInterface() ? *llvm::cast<TypeDecl>(d.instantiate({{"This", d.getType()}}, {})) : d;
+    const TypeDecl& decl = d.isInterface() ? *d.instantiateInterface(d.getType()) : d;
 
     llvm::StructType* structType;
     auto qualifiedName = decl.getQualifiedName();
-    auto it = structs.find(qualifiedName);
+    auto it = structs.find(Identifier::get(qualifiedName));
 
     if (it != structs.end()) {
         structType = it->second.first;
@@ -119,7 +150,7 @@ llvm::StructType* IRGenerator::codegenTypeDecl(const TypeDecl& d) {
             structType = llvm::StructType::create(ctx, qualifiedName);
         }
 
-        structs.try_emplace(qualifiedName, std::make_pair(structType, &decl));
+        structs.try_emplace(Identifier::get(qualifiedName), std::make_pair(structType, &decl));
     }
 
     auto fieldTypes = getFieldTypes(decl);
@@ -138,7 +169,7 @@ llvm::StructType* IRGenerator::codegenTypeDecl(const TypeDecl& d) {
         for (llvm::Type* element : structType->elements()) {
             if (auto* elementStruct = llvm::dyn_cast<llvm::StructType>(element)) {
                 if (elementStruct->isLiteral()) continue;
-                auto it = structs.find(elementStruct->getName());
+                auto it = structs.find(Identifier::get(elementStruct->getName()));
                 if (it != structs.end()) {
                     codegenTypeDecl(*it->second.second);
                 }
@@ -15,18 +15,19 @@ llvm::Value* IRGenerator::codegenStringLiteralExpr(const StringLiteralExpr& expr
     auto* size = llvm::ConstantInt::get(llvm::Type::getInt32Ty(ctx), expr.getValue().size());
     auto* type = getLLVMType(BasicType::get("string", {}));
     auto* alloca = createEntryBlockAlloca(type, nullptr, "__str");
-    llvm::Function* stringConstructor = nullptr;
 
-    for (auto* decl : Module::getStdlibModule()->getSymbolTable().find("string.init")) {
-        auto params = llvm::cast<ConstructorDecl>(decl)->getParams();
-        if (params.size() == 2 && params[0].getType().isPointerType() && params[1].getType().isInt()) {
-            stringConstructor = getFunctionProto(*llvm::cast<ConstructorDecl>(decl));
-            break;
+    if (!stringLiteralConstructor) {
+        for (auto* decl : Module::getStdlibModule()->getSymbolTable().find("string.init")) {
+            auto params = llvm::cast<ConstructorDecl>(decl)->getParams();
+            if (params.size() == 2 && params[0].getType().isPointerType() && params[1].getType().isInt()) {
+                stringLiteralConstructor = llvm::cast<ConstructorDecl>(decl);
+                break;
+            }
         }
     }
 
-    ASSERT(stringConstructor);
-    builder.CreateCall(stringConstructor, {alloca, stringPtr, size});
+    ASSERT(stringLiteralConstructor);
+    builder.CreateCall(getFunctionProto(*stringLiteralConstructor), {alloca, stringPtr, size});
     return alloca;
 }
 
@@ -2,6 +2,8 @@
 #pragma warning(push, 0)
 #include <llvm/ADT/StringSwitch.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/SaveAndRestore.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
 #include "../ast/module.h"
 
@@ -23,7 +25,7 @@ void IRGenScope::clear() {
     destructorsToCall.clear();
 }
 
-IRGenerator::IRGenerator() : builder(ctx) {
+IRGenerator::IRGenerator(llvm::LLVMContext& ctx) : ctx(ctx), builder(ctx) {
     scopes.push_back(IRGenScope(*this));
 }
 
@@ -100,7 +102,7 @@ llvm::Type* IRGenerator::getEnumType(const EnumDecl& enumDecl) {
     if (!enumDecl.hasAssociatedValues()) return tagType;
 
     auto structType = llvm::StructType::create(ctx, enumDecl.getQualifiedName());
-    structs.try_emplace(structType->getName(), std::make_pair(structType, &enumDecl));
+    structs.try_emplace(Identifier::get(structType->getName()), std::make_pair(structType, &enumDecl));
 
     unsigned maxSize = 0;
     for (auto& enumCase : enumDecl.getCases()) {
@@ -115,14 +117,22 @@ llvm::Type* IRGenerator::getEnumType(const EnumDecl& enumDecl) {
 }
 
 llvm::Type* IRGenerator::getStructType(Type type) {
-    auto it = structs.find(type.getQualifiedTypeName());
+    auto cached = structTypesByDecl.find(type.getDecl());
+    if (cached != structTypesByDecl.end()) return cached->second;
+
+    auto it = structs.find(Identifier::get(type.getQualifiedTypeName()));
     if (it != structs.end()) return it->second.first;
 
+    llvm::Type* structType;
+
     if (auto* enumDecl = llvm::dyn_cast<EnumDecl>(type.getDecl())) {
-        return getEnumType(*enumDecl);
+        structType = getEnumType(*enumDecl);
     } else {
-        return codegenTypeDecl(*type.getDecl());
+        structType = codegenTypeDecl(*type.getDecl());
     }
+
+    structTypesByDecl.try_emplace(type.getDecl(), structType);
+    return structType;
 }
 
 llvm::Type* IRGenerator::getLLVMType(Type type, SourceLocation location) {
@@ -313,32 +323,62 @@ llvm::Value* IRGenerator::getFunctionForCall(const CallExpr& call) {
     }
 }
 
-llvm::Module& IRGenerator::codegenModule(const Module& sourceModule) {
+static bool needsBody(const FunctionDecl& decl) {
+    return (!decl.isExtern() || decl.hasBody()) && !decl.hasPrecompiledBody();
+}
+
+llvm::Module& IRGenerator::codegenModule(const Module& sourceModule, bool skipUnreferencedFunctions) {
     ASSERT(!module);
+    llvm::TimeTraceScope timeScope("Codegen module", sourceModule.getName());
     module = new llvm::Module(sourceModule.getName(), ctx);
 
-    for (const auto& sourceFile : sourceModule.getSourceFiles()) {
-        for (const auto& decl : sourceFile.getTopLevelDecls()) {
-            codegenDecl(*decl);
-        }
+    if (skipUnreferencedFunctions) {
+        onDemandModules.try_emplace(&sourceModule, module);
     }
 
-    while (true) {
-        auto currentFunctionInstantiations = functionInstantiations;
+    for (const auto& sourceFile : sourceModule.getSourceFiles()) {
+        for (const auto& decl : sourceFile.getTopLevelDecls()) {
+            if (skipUnreferencedFunctions) {
+                if (auto* functionDecl = llvm::dyn_cast<FunctionDecl>(decl)) {
+                    if (needsBody(*functionDecl)) skippedFunctions.push_back(functionDecl);
+                    continue;
+                }
 
-        for (auto& instantiation : currentFunctionInstantiations) {
-            if (instantiation.decl->isExtern() || !instantiation.function->empty()) continue;
+                if (auto* typeDecl = llvm::dyn_cast<TypeDecl>(decl)) {
+                    for (auto* method : typeDecl->getMethods()) {
+                        auto* methodDecl = llvm::dyn_cast<FunctionDecl>(method);
+                        if (methodDecl && needsBody(*methodDecl)) skippedFunctions.push_back(methodDecl);
+                    }
+                }
+            }
 
-            currentDecl = instantiation.decl;
-            codegenFunctionBody(*instantiation.decl, *instantiation.function);
-            ASSERT(!llvm::verifyFunction(*instantiation.function, &llvm::errs()));
+            codegenDecl(*decl);
         }
-
-        if (functionInstantiations.size() == currentFunctionInstantiations.size()) break;
     }
 
+    codegenReferencedFunctionBodies();
     ASSERT(!llvm::verifyModule(*module, &llvm::errs()));
     generatedModules.push_back(module);
     module = nullptr;
     return *generatedModules.back();
 }
+
+/// Generates the bodies of the referenced functions, each into the module that its prototype was created in.
+/// Generating a body may reference more functions, which are appended to functionInstantiations.
+void IRGenerator::codegenReferencedFunctionBodies() {
+    llvm::SaveAndRestore setModule(module, module);
+
+    for (; nextFunctionInstantiation < functionInstantiations.size(); ++nextFunctionInstantiation) {
+        auto instantiation = functionInstantiations[nextFunctionInstantiation];
+        if (!needsBody(*instantiation.decl) || !instantiation.function->empty()) continue;
+
+        module = instantiation.function->getParent();
+        currentDecl = instantiation.decl;
+        codegenFunctionBody(*instantiation.decl, *instantiation.function);
+        ASSERT(!llvm::verifyFunction(*instantiation.function, &llvm::errs()));
+    }
+}
+
+size_t IRGenerator::getSkippedFunctionCount() const {
+    return llvm::count_if(skippedFunctions, [&](const FunctionDecl* decl) { return generatedFunctions.count(decl) == 0; });
+}
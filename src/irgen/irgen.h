@@ -3,12 +3,14 @@
 #include <vector>
 #pragma warning(push, 0)
 #include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/ADT/StringMap.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 #pragma warning(pop)
 #include "../ast/decl.h"
 #include "../ast/expr.h"
+#include "../ast/identifier.h"
 #include "../ast/stmt.h"
 #include "../sema/typecheck.h"
 
@@ -38,8 +40,13 @@ struct IRGenScope {
 
 class IRGenerator {
 public:
-    IRGenerator();
-    llvm::Module& codegenModule(const Module& sourceModule);
+    IRGenerator(llvm::LLVMContext& ctx);
+    /// Generates IR for the given module. If skipUnreferencedFunctions is set, the module's function bodies are
+    /// only generated once they're referenced, e.g. by a module generated later that imports this module.
+    llvm::Module& codegenModule(const Module& sourceModule, bool skipUnreferencedFunctions = false);
+    /// Returns the number of functions that were skipped because of skipUnreferencedFunctions and never referenced.
+    size_t getSkippedFunctionCount() const;
+    size_t getGeneratedFunctionCount() const { return generatedFunctions.size(); }
     llvm::LLVMContext& getLLVMContext() { return ctx; }
     std::vector<llvm::Module*> getGeneratedModules() { return std::move(generatedModules); }
 
@@ -47,6 +54,7 @@ private:
     friend struct IRGenScope;
 
     void codegenFunctionBody(const FunctionDecl& decl, llvm::Function& function);
+    void codegenReferencedFunctionBodies();
     void createDestructorCall(llvm::Function* destructor, llvm::Value* receiver);
 
     /// 'decl' is null if this is the 'this' value.
@@ -122,6 +130,7 @@ private:
 
     llvm::Value* getFunctionForCall(const CallExpr& call);
     llvm::Function* getFunctionProto(const FunctionDecl& decl);
+    llvm::Module* getOnDemandModule(const FunctionDecl& decl) const;
     llvm::AllocaInst* createEntryBlockAlloca(llvm::Type* type, llvm::Value* arraySize = nullptr, const llvm::Twine& name = "");
     llvm::AllocaInst* createTempAlloca(llvm::Value* value, const llvm::Twine& name = "");
     llvm::Value* createLoad(llvm::Value* value);
@@ -149,14 +158,28 @@ private:
 
     std::vector<IRGenScope> scopes;
 
-    llvm::LLVMContext ctx;
+    llvm::LLVMContext& ctx;
     llvm::IRBuilder<> builder;
     llvm::Module* module = nullptr;
     std::vector<llvm::Module*> generatedModules;
     llvm::BasicBlock::iterator lastAlloca;
 
+    /// Functions whose bodies are to be generated, in the order they were first referenced. The ones before
+    /// nextFunctionInstantiation have been processed already.
     std::vector<FunctionInstantiation> functionInstantiations;
-    llvm::StringMap<std::pair<llvm::StructType*, const TypeDecl*>> structs;
+    size_t nextFunctionInstantiation = 0;
+    /// The LLVM modules of the source modules generated with skipUnreferencedFunctions.
+    llvm::DenseMap<const Module*, llvm::Module*> onDemandModules;
+    std::vector<const FunctionDecl*> skippedFunctions;
+    llvm::DenseSet<const FunctionDecl*> generatedFunctions;
+    /// The generated struct types by their interned name. Types from different modules with the same name, e.g. a C
+    /// struct imported by multiple headers, share the same LLVM type.
+    llvm::DenseMap<Identifier, std::pair<llvm::StructType*, const TypeDecl*>> structs;
+    /// Caches the LLVM types returned by getStructType, so that the type's qualified name doesn't have to be built for
+    /// each lookup.
+    llvm::DenseMap<const TypeDecl*, llvm::Type*> structTypesByDecl;
+    /// The string constructor called for string literals, taking a pointer and a size.
+    ConstructorDecl* stringLiteralConstructor = nullptr;
     const Decl* currentDecl;
 
     /// The basic blocks to branch to on a 'break'/'continue' statement.
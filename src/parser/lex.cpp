@@ -9,21 +9,21 @@
 #include <llvm/Support/MemoryBuffer.h>
 #pragma warning(pop)
 #include "parse.h"
+#include "../ast/compilation-context.h"
+#include "../ast/identifier.h"
 #include "../ast/token.h"
 #include "../support/utility.h"
 
 using namespace delta;
 
-std::vector<llvm::MemoryBuffer*> Lexer::fileBuffers;
-
-Lexer::Lexer(llvm::MemoryBuffer* input)
-: firstLocation(input->getBufferIdentifier().data(), 1, 0), lastLocation(input->getBufferIdentifier().data(), 1, 0) {
-    fileBuffers.push_back(input);
-    currentFilePosition = fileBuffers.back()->getBufferStart() - 1;
+Lexer::Lexer(std::unique_ptr<llvm::MemoryBuffer> input)
+: fileBuffer(input.get()), currentFilePosition(input->getBufferStart() - 1), firstLocation(input->getBufferIdentifier().data(), 1, 0),
+  lastLocation(input->getBufferIdentifier().data(), 1, 0) {
+    CompilationContext::getCurrent().fileBuffers.push_back(std::move(input));
 }
 
 const char* Lexer::getFilePath() const {
-    return fileBuffers.back()->getBufferIdentifier().data();
+    return fileBuffer->getBufferIdentifier().data();
 }
 
 SourceLocation Lexer::getCurrentLocation() const {
@@ -404,7 +404,8 @@ Token Lexer::nextToken() {
                     return Token(it->second, getCurrentLocation(), string);
                 }
 
-                return Token(Token::Identifier, getCurrentLocation(), string);
+                // Identifiers are interned as they are lexed, so that symbol tables can be keyed by the interned identifier.
+                return Token(Token::Identifier, getCurrentLocation(), Identifier::get(string));
         }
     }
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vector>
+#include <memory>
 #include "../ast/token.h"
 
 namespace llvm {
@@ -13,12 +13,11 @@ struct SourceLocation;
 
 class Lexer {
 public:
-    Lexer(llvm::MemoryBuffer* input);
+    /// The buffer is moved into the current CompilationContext, which keeps it alive for the source locations.
+    Lexer(std::unique_ptr<llvm::MemoryBuffer> input);
     Token nextToken();
     const char* getFilePath() const;
 
-    static std::vector<llvm::MemoryBuffer*> fileBuffers; // TODO: Make this non-static.
-
 private:
     SourceLocation getCurrentLocation() const;
     char readChar();
@@ -27,6 +26,7 @@ private:
     Token readQuotedLiteral(char delimiter, Token::Kind literalKind);
     Token readNumber();
 
+    const llvm::MemoryBuffer* fileBuffer;
     const char* currentFilePosition;
     SourceLocation firstLocation;
     SourceLocation lastLocation;
@@ -10,20 +10,22 @@
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/SaveAndRestore.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
 #include "lex.h"
 #include "../ast/decl.h"
 #include "../ast/module.h"
 #include "../ast/token.h"
 #include "../driver/driver.h"
+#include "../support/stats.h"
 #include "../support/utility.h"
 
 using namespace delta;
 
-static llvm::MemoryBuffer* getFileMemoryBuffer(llvm::StringRef filePath) {
+static std::unique_ptr<llvm::MemoryBuffer> getFileMemoryBuffer(llvm::StringRef filePath) {
     auto buffer = llvm::MemoryBuffer::getFile(filePath);
     if (!buffer) ABORT("couldn't open file '" << filePath << "'");
-    return buffer->release();
+    return std::move(*buffer);
 }
 
 Parser::Parser(llvm::StringRef filePath, Module& module, const CompileOptions& options)
@@ -1159,10 +1161,20 @@ FunctionTemplate* Parser::parseFunctionTemplate(TypeDecl* receiverTypeDecl, Acce
     return decl;
 }
 
-/// extern-function-decl ::= 'extern' function-proto ('\n' | ';')
+/// extern-function-decl ::= 'extern' function-proto (('\n' | ';') | '{' stmt* '}')
+///
+/// An extern function with a body is defined with an unmangled name, so that it can be called from C or from a
+/// separately compiled module that declares it as an extern function.
 FunctionDecl* Parser::parseExternFunctionDecl(Type type, llvm::StringRef name, SourceLocation location) {
     auto decl = parseFunctionProto(true, nullptr, AccessLevel::Default, nullptr, type, name, location);
-    parseStmtTerminator();
+
+    if (currentToken() == Token::LeftBrace) {
+        if (decl->isVariadic()) ERROR(location, "variadic extern functions can't have a body");
+        decl->setBody(parseBlock(decl));
+    } else {
+        parseStmtTerminator();
+    }
+
     return decl;
 }
 
@@ -1519,6 +1531,7 @@ Decl* Parser::parseTopLevelFunctionOrVariable(bool isExtern, bool addToSymbolTab
 }
 
 void Parser::parse() {
+    llvm::TimeTraceScope timeScope("Parse", llvm::StringRef(lexer.getFilePath()));
     std::vector<Decl*> topLevelDecls;
     SourceFile sourceFile(lexer.getFilePath());
 
@@ -1538,4 +1551,5 @@ void Parser::parse() {
 
     sourceFile.setDecls(std::move(topLevelDecls));
     currentModule->addSourceFile(std::move(sourceFile));
+    addStatistic("tokens", lexer.getFilePath(), tokenBuffer.size());
 }
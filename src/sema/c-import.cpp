@@ -23,17 +23,20 @@
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/Program.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
 #include "typecheck.h"
 #include "../ast/decl.h"
 #include "../ast/module.h"
 #include "../ast/type.h"
 #include "../driver/driver.h"
+#include "../support/stats.h"
 #include "../support/utility.h"
 
 using namespace delta;
 
-static clang::TargetInfo* targetInfo;
+/// Per thread, because C headers may be imported by the frontends of multiple targets concurrently.
+static thread_local clang::TargetInfo* targetInfo;
 
 static Type getIntTypeByWidth(int widthInBits, bool asSigned) {
     switch (widthInBits) {
@@ -323,6 +326,8 @@ bool delta::importCHeader(SourceFile& importer, llvm::StringRef headerName, cons
         return true;
     }
 
+    llvm::TimeTraceScope timeScope("Import C header", headerName);
+    PhaseStatistics phaseStatistics("import-c-header");
     auto module = new Module(headerName);
 
     clang::CompilerInstance ci;
@@ -373,6 +378,10 @@ bool delta::importCHeader(SourceFile& importer, llvm::StringRef headerName, cons
         return false;
     }
 
+    for (auto it = ci.getSourceManager().fileinfo_begin(), end = ci.getSourceManager().fileinfo_end(); it != end; ++it) {
+        module->addHeaderFile(it->first->getName());
+    }
+
     importer.addImportedModule(module);
     Module::getAllImportedModulesMap()[module->getName()] = module;
     return true;
@@ -2,6 +2,7 @@
 #pragma warning(push, 0)
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/Support/SaveAndRestore.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
 #include "c-import.h"
 #include "../ast/module.h"
@@ -34,9 +35,7 @@ void Typechecker::typecheckType(Type type, AccessLevel userAccessLevel) {
 
                 ASSERT(decls.size() == 1);
                 decl = decls[0];
-                auto instantiation = llvm::cast<TypeTemplate>(decl)->instantiate(basicType->getGenericArgs());
-                getCurrentModule()->addToSymbolTable(*instantiation);
-                declsToTypecheck.push_back(instantiation);
+                instantiateTypeTemplate(*llvm::cast<TypeTemplate>(decl), basicType->getGenericArgs());
             } else {
                 ASSERT(decls.size() == 1);
                 decl = decls[0];
@@ -62,9 +61,7 @@ void Typechecker::typecheckType(Type type, AccessLevel userAccessLevel) {
                 auto qualifiedTypeName = getQualifiedTypeName("ArrayRef", type.getElementType());
                 if (findDecls(qualifiedTypeName).empty()) {
                     auto* arrayRef = llvm::cast<TypeTemplate>(findDecl("ArrayRef", SourceLocation()));
-                    auto* instantiation = arrayRef->instantiate({type.getElementType()});
-                    getCurrentModule()->addToSymbolTable(*instantiation);
-                    declsToTypecheck.push_back(instantiation);
+                    instantiateTypeTemplate(*arrayRef, type.getElementType());
                 }
             }
             typecheckType(type.getElementType(), userAccessLevel);
@@ -150,13 +147,18 @@ void Typechecker::typecheckParams(llvm::MutableArrayRef<ParamDecl> params, Acces
 }
 
 void Typechecker::typecheckFunctionDecl(FunctionDecl& decl) {
-    if (decl.isTypechecked()) return;
-    if (decl.isExtern()) return; // TODO: Typecheck parameters and return type of extern functions.
+    if (decl.isTypechecked() || llvm::is_contained(typecheckedDecls, &decl)) return;
+    if (decl.isExtern() && !decl.hasBody()) return; // TODO: Typecheck parameters and return type of extern functions.
+    // Typechecking a function from the body of another one, other than a lambda, modifies a decl the body doesn't own.
+    if (functionContext->function && !decl.isLambda()) checkCanModifySharedState();
 
+    llvm::TimeTraceScope timeScope("Typecheck function", [&] { return decl.getQualifiedName(); });
     TypeDecl* receiverTypeDecl = decl.getTypeDecl();
 
     Scope scope(&decl, &currentModule->getSymbolTable());
-    llvm::SaveAndRestore setCurrentFunction(currentFunction, &decl);
+    FunctionTypecheckContext context;
+    context.function = &decl;
+    llvm::SaveAndRestore setFunctionContext(functionContext, &context);
 
     typecheckParams(decl.getParams(), decl.getAccessLevel());
 
@@ -169,10 +171,18 @@ void Typechecker::typecheckFunctionDecl(FunctionDecl& decl) {
         typecheckType(decl.getReturnType(), decl.getAccessLevel());
     }
 
-    if (!decl.isExtern()) {
+    if (decl.hasPrecompiledBody()) {
+        // The body was already type-checked when the precompiled module was built.
+        markTypechecked(decl);
+        return;
+    }
+
+    if (deferBodyTypechecking(decl)) return;
+
+    if (!decl.isExtern() || decl.hasBody()) {
         llvm::SmallPtrSet<FieldDecl*, 32> initializedFields;
-        llvm::SaveAndRestore setReturnType(functionReturnType, decl.getReturnType());
-        llvm::SaveAndRestore setInitializedFields(currentInitializedFields, &initializedFields);
+        context.returnType = decl.getReturnType();
+        context.initializedFields = &initializedFields;
 
         if (receiverTypeDecl) {
             Type thisType = receiverTypeDecl->getTypeForPassing();
@@ -184,10 +194,8 @@ void Typechecker::typecheckFunctionDecl(FunctionDecl& decl) {
 
         if (decl.hasBody()) {
             for (auto& stmt : decl.getBody()) {
-                {
-                    llvm::SaveAndRestore setCurrentStmt(currentStmt, &stmt);
-                    typecheckStmt(stmt);
-                }
+                typecheckStmt(stmt);
+                analyzeTopLevelStmtNullChecks(*stmt);
 
                 if (decl.isConstructorDecl()) {
                     if (auto* exprStmt = llvm::dyn_cast<ExprStmt>(stmt)) {
@@ -204,7 +212,7 @@ void Typechecker::typecheckFunctionDecl(FunctionDecl& decl) {
             }
 
             // This prevents creating destructors calls during codegen.
-            for (auto* movedDecl : movedDecls) {
+            for (auto* movedDecl : context.movedDecls) {
                 switch (movedDecl->getKind()) {
                     case DeclKind::ParamDecl:
                         llvm::cast<ParamDecl>(movedDecl)->setMoved(true);
@@ -216,7 +224,6 @@ void Typechecker::typecheckFunctionDecl(FunctionDecl& decl) {
                         break;
                 }
             }
-            movedDecls.clear();
         }
 
         if (decl.isConstructorDecl() && !delegatedInit) {
@@ -232,7 +239,7 @@ void Typechecker::typecheckFunctionDecl(FunctionDecl& decl) {
         REPORT_ERROR(decl.getLocation(), "'" << decl.getName() << "' is missing a return statement");
     }
 
-    decl.setTypechecked(true);
+    markTypechecked(decl);
 }
 
 void Typechecker::typecheckFunctionTemplate(FunctionTemplate& decl) {
@@ -260,7 +267,7 @@ void Typechecker::typecheckTypeDecl(TypeDecl& decl) {
 
     if (decl.isInterface()) {
         // TODO: Move this to typecheckModule to the pre-typechecking phase?
-        realDecl = llvm::cast<TypeDecl>(decl.instantiate({{"This", decl.getType()}}, {}));
+        realDecl = decl.instantiateInterface(decl.getType());
     } else {
         realDecl = &decl;
     }
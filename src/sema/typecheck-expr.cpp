@@ -13,6 +13,7 @@
 #include "../ast/expr.h"
 #include "../ast/module.h"
 #include "../ast/type.h"
+#include "../support/stats.h"
 
 using namespace delta;
 
@@ -35,7 +36,7 @@ void Typechecker::checkLambdaCapture(const VariableDecl& variableDecl, const Var
 Type Typechecker::typecheckVarExpr(VarExpr& expr, bool useIsWriteOnly) {
     auto* decl = findDecl(expr.getIdentifier(), expr.getLocation());
     checkHasAccess(*decl, expr.getLocation(), AccessLevel::None);
-    decl->setReferenced(true);
+    markReferenced(*decl);
     expr.setDecl(decl);
 
     if (auto variableDecl = llvm::dyn_cast<VariableDecl>(decl)) {
@@ -312,7 +313,7 @@ void Typechecker::typecheckAssignment(BinaryExpr& expr, SourceLocation location)
     Type lhsType = lhs->getAssignableType();
     Type rhsType = typecheckExpr(*rhs, false, lhsType);
 
-    if (rhs->isUndefinedLiteralExpr() && !allowAssignmentOfUndefined(*lhs, currentFunction)) {
+    if (rhs->isUndefinedLiteralExpr() && !allowAssignmentOfUndefined(*lhs, functionContext->function)) {
         ERROR(rhs->getLocation(), "'undefined' is only allowed as an initial value");
     }
 
@@ -343,9 +344,9 @@ void Typechecker::typecheckAssignment(BinaryExpr& expr, SourceLocation location)
         setMoved(lhs, false);
     }
 
-    if (currentInitializedFields) {
+    if (functionContext->initializedFields) {
         if (auto fieldDecl = lhs->getFieldDecl()) {
-            currentInitializedFields->insert(fieldDecl);
+            functionContext->initializedFields->insert(fieldDecl);
         }
     }
 }
@@ -378,7 +379,7 @@ bool Typechecker::hasMethod(TypeDecl& type, FunctionDecl& functionDecl) const {
 }
 
 bool Typechecker::providesInterfaceRequirements(TypeDecl& type, TypeDecl& interface, std::string* errorReason) const {
-    auto thisTypeResolvedInterface = llvm::cast<TypeDecl>(interface.instantiate({{"This", type.getType()}}, {}));
+    auto thisTypeResolvedInterface = interface.instantiateInterface(type.getType());
 
     for (auto& fieldRequirement : thisTypeResolvedInterface->getFields()) {
         if (!hasField(type, fieldRequirement)) {
@@ -851,7 +852,123 @@ static bool equals(const llvm::StringMap<Type>& a, const llvm::StringMap<Type>&
     return true;
 }
 
+/// Returns false if the call can't match the given parameters because of its number of arguments or their names.
+/// Candidates are filtered with this before the more expensive argument type checks and generic argument inference.
+static bool argumentCountAndNamesMatch(const CallExpr& expr, llvm::ArrayRef<ParamDecl> params, bool isVariadic) {
+    auto args = expr.getArgs();
+
+    if (args.size() < params.size() || (!isVariadic && args.size() > params.size())) {
+        addStatistic("overload-resolution", "filtered-candidates");
+        return false;
+    }
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (!args[i].getName().empty() && (i >= params.size() || args[i].getName() != params[i].getName())) {
+            addStatistic("overload-resolution", "filtered-candidates");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool argumentCountAndNamesMatch(const CallExpr& expr, const FunctionDecl& functionDecl) {
+    return argumentCountAndNamesMatch(expr, functionDecl.getParams(), functionDecl.isVariadic());
+}
+
+bool OverloadResolutionKey::operator==(const OverloadResolutionKey& other) const {
+    if (expectedType ? !other.expectedType || expectedType != other.expectedType : bool(other.expectedType)) return false;
+    return candidates == other.candidates && argTypes == other.argTypes && argNames == other.argNames && argIsLvalue == other.argIsLvalue &&
+           genericArgs == other.genericArgs;
+}
+
+size_t OverloadResolutionKey::Hash::operator()(const OverloadResolutionKey& key) const {
+    llvm::hash_code hashValue = llvm::hash_combine_range(key.candidates.begin(), key.candidates.end());
+
+    for (auto types : {llvm::ArrayRef<Type>(key.argTypes), llvm::ArrayRef<Type>(key.genericArgs)}) {
+        for (Type type : types) {
+            hashValue = llvm::hash_combine(hashValue, type.getBase()->getStructuralHash(), type.isMutable());
+        }
+    }
+
+    for (size_t i = 0; i < key.argNames.size(); ++i) {
+        hashValue = llvm::hash_combine(hashValue, key.argNames[i], bool(key.argIsLvalue[i]));
+    }
+
+    if (key.expectedType) {
+        hashValue = llvm::hash_combine(hashValue, key.expectedType.getBase()->getStructuralHash(), key.expectedType.isMutable());
+    }
+
+    return hashValue;
+}
+
+/// Returns the key for memoizing the overload resolution of the given call, or None if its result shouldn't be
+/// memoized. Calls with arguments whose type depends on the parameter they're passed to, e.g. null literals and calls
+/// to generic functions, aren't memoized, because those arguments can only be typechecked during overload resolution.
+llvm::Optional<OverloadResolutionKey> Typechecker::getOverloadResolutionKey(llvm::ArrayRef<Decl*> decls, CallExpr& expr,
+                                                                            Type expectedType) {
+    // Resolving a call to a single non-generic function doesn't involve choosing between candidates.
+    if (decls.size() == 1 && !decls[0]->isFunctionTemplate()) return llvm::None;
+
+    for (auto* decl : decls) {
+        if (!decl->isFunctionTemplate() && (!decl->isFunctionDecl() || decl->isDestructorDecl())) return llvm::None;
+    }
+
+    for (auto& arg : expr.getArgs()) {
+        switch (arg.getValue()->getKind()) {
+            case ExprKind::NullLiteralExpr:
+            case ExprKind::UndefinedLiteralExpr:
+            case ExprKind::ArrayLiteralExpr:
+            case ExprKind::CallExpr:
+            case ExprKind::LambdaExpr:
+            // The implicit conversions of these depend on the expression and not only on its type.
+            case ExprKind::StringLiteralExpr:
+            case ExprKind::TupleExpr:
+            case ExprKind::IfExpr:
+                return llvm::None;
+            default:
+                break;
+        }
+    }
+
+    OverloadResolutionKey key;
+    key.candidates = decls;
+    key.genericArgs = expr.getGenericArgs();
+    key.expectedType = expectedType;
+
+    for (auto& arg : expr.getArgs()) {
+        auto* argValue = arg.getValue();
+        key.argTypes.push_back(argValue->hasType() ? argValue->getType() : typecheckExpr(*argValue));
+        // Constants are implicitly converted to any integer or floating-point parameter type their value fits in.
+        if (argValue->isConstant()) return llvm::None;
+        key.argNames.push_back(arg.getName().str());
+        key.argIsLvalue.push_back(argValue->isLvalue());
+    }
+
+    return key;
+}
+
+/// Memoizes the selected declaration for calls whose arguments are typechecked up front. The arguments are still
+/// validated against the selected declaration for each call, which converts them to the parameter types.
 Decl* Typechecker::resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr, llvm::StringRef callee, Type expectedType) {
+    auto key = getOverloadResolutionKey(decls, expr, expectedType);
+
+    if (key) {
+        auto it = resolvedOverloads.find(*key);
+        if (it != resolvedOverloads.end()) {
+            addStatistic("overload-resolution", "memo-hits");
+            validateArgs(expr, *it->second, callee, expr.getCallee().getLocation());
+            declsToTypecheck.push_back(it->second);
+            return it->second;
+        }
+    }
+
+    auto* decl = selectOverload(decls, expr, callee, expectedType);
+    if (key) resolvedOverloads.emplace(std::move(*key), decl);
+    return decl;
+}
+
+Decl* Typechecker::selectOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr, llvm::StringRef callee, Type expectedType) {
     std::vector<Decl*> matches;
     std::vector<Decl*> templateMatches;
     llvm::ArrayRef<Decl*> candidates = decls;
@@ -871,6 +988,8 @@ Decl* Typechecker::resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr,
                     continue;
                 }
 
+                if (decls.size() != 1 && !argumentCountAndNamesMatch(expr, *functionTemplate->getFunctionDecl())) continue;
+
                 auto genericArgs = getGenericArgsForCall(genericParams, expr, functionTemplate->getFunctionDecl(), decls.size() != 1,
                                                          expectedType);
                 if (genericArgs.empty()) continue; // Couldn't infer generic arguments.
@@ -897,7 +1016,7 @@ Decl* Typechecker::resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr,
                     validateArgs(expr, functionDecl, callee, expr.getCallee().getLocation());
                     return &functionDecl;
                 }
-                if (argumentsMatch(expr, &functionDecl)) {
+                if (argumentCountAndNamesMatch(expr, functionDecl) && argumentsMatch(expr, &functionDecl)) {
                     matches.push_back(&functionDecl);
                 }
                 break;
@@ -916,7 +1035,7 @@ Decl* Typechecker::resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr,
                         validateArgs(expr, *constructorDecl, callee, expr.getCallee().getLocation());
                         return constructorDecl;
                     }
-                    if (argumentsMatch(expr, constructorDecl)) {
+                    if (argumentCountAndNamesMatch(expr, *constructorDecl) && argumentsMatch(expr, constructorDecl)) {
                         matches.push_back(constructorDecl);
                     }
                 }
@@ -932,6 +1051,7 @@ Decl* Typechecker::resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr,
                 std::vector<llvm::StringMap<Type>> genericArgSets;
 
                 for (auto* constructorDecl : constructorDecls) {
+                    if (constructorDecls.size() != 1 && !argumentCountAndNamesMatch(expr, *constructorDecl)) continue;
                     auto genericArgs = getGenericArgsForCall(typeTemplate->getGenericParams(), expr, constructorDecl,
                                                              constructorDecls.size() != 1, expectedType);
                     if (genericArgs.empty()) continue; // Couldn't infer generic arguments.
@@ -941,25 +1061,16 @@ Decl* Typechecker::resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr,
                 }
 
                 for (auto& genericArgs : genericArgSets) {
-                    TypeDecl* typeDecl = nullptr;
-
-                    auto genericArgTypes = map(genericArgs, [](auto& entry) { return entry.getValue(); });
-                    auto typeDecls = findDecls(getQualifiedTypeName(typeTemplate->getTypeDecl()->getName(), genericArgTypes));
-
-                    if (typeDecls.empty()) {
-                        typeDecl = typeTemplate->instantiate(genericArgs);
-                        getCurrentModule()->addToSymbolTable(*typeDecl);
-                        declsToTypecheck.push_back(typeDecl);
-                    } else {
-                        typeDecl = llvm::cast<TypeDecl>(typeDecls[0]);
-                    }
+                    auto genericArgTypes = map(typeTemplate->getGenericParams(),
+                                               [&](auto& genericParam) { return genericArgs.find(genericParam.getName())->second; });
+                    auto* typeDecl = instantiateTypeTemplate(*typeTemplate, genericArgTypes);
 
                     for (auto* constructorDecl : typeDecl->getConstructors()) {
                         if (constructorDecls.size() == 1) {
                             validateArgs(expr, *constructorDecl, callee, expr.getCallee().getLocation());
                             return constructorDecl;
                         }
-                        if (argumentsMatch(expr, constructorDecl)) {
+                        if (argumentCountAndNamesMatch(expr, *constructorDecl) && argumentsMatch(expr, constructorDecl)) {
                             templateMatches.push_back(constructorDecl);
                         }
                     }
@@ -1157,7 +1268,7 @@ Type Typechecker::typecheckCallExpr(CallExpr& expr, Type expectedType) {
     }
 
     expr.setCalleeDecl(decl);
-    decl->setReferenced(true);
+    markReferenced(*decl);
 
     if (auto constructorDecl = llvm::dyn_cast<ConstructorDecl>(decl)) {
         if (constructorDecl->getTypeDecl()->isInterface()) {
@@ -1583,15 +1694,15 @@ void Typechecker::setMoved(Expr* expr, bool isMoved) {
         ASSERT(varExpr->getDecl());
 
         if (isMoved) {
-            movedDecls.insert(varExpr->getDecl());
+            functionContext->movedDecls.insert(varExpr->getDecl());
         } else {
-            movedDecls.erase(varExpr->getDecl());
+            functionContext->movedDecls.erase(varExpr->getDecl());
         }
     }
 }
 
 void Typechecker::checkNotMoved(const Decl& decl, const VarExpr& expr) {
-    if (movedDecls.count(&decl)) {
+    if (functionContext->movedDecls.count(&decl)) {
         ERROR(expr.getLocation(), "use of moved value '" << expr.getIdentifier() << "'");
     }
 }
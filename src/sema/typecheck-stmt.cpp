@@ -35,26 +35,26 @@ void Typechecker::checkReturnPointerToLocal(const ReturnStmt& stmt) const {
         }
     }
 
-    if (localVariableType && functionReturnType.removeOptional().isPointerType() &&
-        functionReturnType.removeOptional().getPointee().equalsIgnoreTopLevelMutable(localVariableType)) {
+    if (localVariableType && functionContext->returnType.removeOptional().isPointerType() &&
+        functionContext->returnType.removeOptional().getPointee().equalsIgnoreTopLevelMutable(localVariableType)) {
         WARN(returnValue->getLocation(), "returning pointer to local variable (local variables will not exist after the function returns)");
     }
 }
 
 void Typechecker::typecheckReturnStmt(ReturnStmt& stmt) {
     if (!stmt.getReturnValue()) {
-        if (!functionReturnType.isVoid()) {
-            ERROR(stmt.getLocation(), "expected return statement to return a value of type '" << functionReturnType << "'");
+        if (!functionContext->returnType.isVoid()) {
+            ERROR(stmt.getLocation(), "expected return statement to return a value of type '" << functionContext->returnType << "'");
         }
         return;
     }
 
-    Type returnValueType = typecheckExpr(*stmt.getReturnValue(), false, functionReturnType);
+    Type returnValueType = typecheckExpr(*stmt.getReturnValue(), false, functionContext->returnType);
 
-    if (auto converted = convert(stmt.getReturnValue(), functionReturnType)) {
+    if (auto converted = convert(stmt.getReturnValue(), functionContext->returnType)) {
         stmt.setReturnValue(converted);
     } else {
-        ERROR(stmt.getLocation(), "mismatching return type '" << returnValueType << "', expected '" << functionReturnType << "'");
+        ERROR(stmt.getLocation(), "mismatching return type '" << returnValueType << "', expected '" << functionContext->returnType << "'");
     }
 
     checkReturnPointerToLocal(stmt);
@@ -72,23 +72,27 @@ void Typechecker::typecheckIfStmt(IfStmt& ifStmt) {
         ERROR(ifStmt.getCondition().getLocation(), "'if' condition must have type 'bool' or optional type");
     }
 
-    currentControlStmts.push_back(&ifStmt);
+    functionContext->controlStmts.push_back(&ifStmt);
+    beginNullCheckedStmts(ifStmt);
 
     {
-        llvm::SaveAndRestore thenMovedDecls(movedDecls);
+        llvm::SaveAndRestore thenMovedDecls(functionContext->movedDecls);
         for (auto& stmt : ifStmt.getThenBody()) {
             typecheckStmt(stmt);
+            analyzeNullCheckedStmt(ifStmt, *stmt);
         }
     }
 
     {
-        llvm::SaveAndRestore elseMovedDecls(movedDecls);
+        llvm::SaveAndRestore elseMovedDecls(functionContext->movedDecls);
         for (auto& stmt : ifStmt.getElseBody()) {
             typecheckStmt(stmt);
+            analyzeNullCheckedStmt(ifStmt, *stmt);
         }
     }
 
-    currentControlStmts.pop_back();
+    endNullCheckedStmts(ifStmt);
+    functionContext->controlStmts.pop_back();
 }
 
 void Typechecker::typecheckSwitchStmt(SwitchStmt& stmt) {
@@ -98,7 +102,7 @@ void Typechecker::typecheckSwitchStmt(SwitchStmt& stmt) {
         ERROR(stmt.getCondition().getLocation(), "switch condition must have integer, char, or enum type, got '" << conditionType << "'");
     }
 
-    currentControlStmts.push_back(&stmt);
+    functionContext->controlStmts.push_back(&stmt);
 
     for (auto& switchCase : stmt.getCases()) {
         Type caseType = typecheckExpr(*switchCase.getValue());
@@ -127,11 +131,11 @@ void Typechecker::typecheckSwitchStmt(SwitchStmt& stmt) {
         typecheckStmt(defaultStmt);
     }
 
-    currentControlStmts.pop_back();
+    functionContext->controlStmts.pop_back();
 }
 
 void Typechecker::typecheckForStmt(ForStmt& forStmt) {
-    Scope scope(currentFunction, &currentModule->getSymbolTable());
+    Scope scope(functionContext->function, &currentModule->getSymbolTable());
 
     if (forStmt.getVariable()) {
         typecheckVarStmt(*forStmt.getVariable());
@@ -145,13 +149,16 @@ void Typechecker::typecheckForStmt(ForStmt& forStmt) {
         }
     }
 
-    currentControlStmts.push_back(&forStmt);
+    functionContext->controlStmts.push_back(&forStmt);
+    beginNullCheckedStmts(forStmt);
 
     for (auto& stmt : forStmt.getBody()) {
         typecheckStmt(stmt);
+        analyzeNullCheckedStmt(forStmt, *stmt);
     }
 
-    currentControlStmts.pop_back();
+    endNullCheckedStmts(forStmt);
+    functionContext->controlStmts.pop_back();
 
     if (auto* increment = forStmt.getIncrement()) {
         typecheckExpr(*increment);
@@ -159,19 +166,19 @@ void Typechecker::typecheckForStmt(ForStmt& forStmt) {
 }
 
 void Typechecker::typecheckBreakStmt(BreakStmt& breakStmt) {
-    if (llvm::none_of(currentControlStmts, [](const Stmt* stmt) { return stmt->isBreakable(); })) {
+    if (llvm::none_of(functionContext->controlStmts, [](const Stmt* stmt) { return stmt->isBreakable(); })) {
         ERROR(breakStmt.getLocation(), "'break' is only allowed inside 'while', 'for', and 'switch' statements");
     }
 }
 
 void Typechecker::typecheckContinueStmt(ContinueStmt& continueStmt) {
-    if (llvm::none_of(currentControlStmts, [](const Stmt* stmt) { return stmt->isContinuable(); })) {
+    if (llvm::none_of(functionContext->controlStmts, [](const Stmt* stmt) { return stmt->isContinuable(); })) {
         ERROR(continueStmt.getLocation(), "'continue' is only allowed inside 'while' and 'for' statements");
     }
 }
 
 void Typechecker::typecheckCompoundStmt(CompoundStmt& compoundStmt) {
-    Scope scope(currentFunction, &currentModule->getSymbolTable());
+    Scope scope(functionContext->function, &currentModule->getSymbolTable());
 
     for (auto& stmt : compoundStmt.getBody()) {
         typecheckStmt(stmt);
@@ -211,7 +218,7 @@ void Typechecker::typecheckStmt(Stmt*& stmt) {
             case StmtKind::ForEachStmt: {
                 auto* forEachStmt = llvm::cast<ForEachStmt>(stmt);
                 typecheckExpr(forEachStmt->getRangeExpr());
-                auto nestLevel = llvm::count_if(currentControlStmts, [](auto* stmt) { return stmt->isForStmt(); });
+                auto nestLevel = llvm::count_if(functionContext->controlStmts, [](auto* stmt) { return stmt->isForStmt(); });
                 stmt = forEachStmt->lower(nestLevel);
                 typecheckStmt(stmt);
                 break;
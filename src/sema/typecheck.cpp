@@ -1,16 +1,25 @@
 #include "typecheck.h"
 #pragma warning(push, 0)
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/SaveAndRestore.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/TimeProfiler.h>
 #pragma warning(pop)
 #include "../ast/module.h"
 #include "../driver/driver.h"
 #include "../package-manager/manifest.h"
 #include "../parser/parse.h"
+#include "../support/stats.h"
 
 using namespace delta;
 
+static llvm::DenseMap<FunctionDecl*, SourceFile*>& getUncheckedFunctionBodies() {
+    return CompilationContext::getCurrent().uncheckedFunctionBodies;
+}
+
 static const Expr& getIfOrWhileCondition(const Stmt& ifOrWhileStmt) {
     switch (ifOrWhileStmt.getKind()) {
         case StmtKind::IfStmt:
@@ -55,23 +64,31 @@ static llvm::Optional<bool> memberExprChainsMatch(const MemberExpr& a, const Mem
     }
 }
 
+static bool isSameNullableValue(const Expr& checkedValue, const Expr& expr) {
+    switch (expr.getKind()) {
+        case ExprKind::VarExpr: {
+            auto* decl = llvm::cast<VarExpr>(expr).getDecl();
+            auto* lhs = llvm::dyn_cast<VarExpr>(&checkedValue);
+            return decl && lhs && lhs->getDecl() == decl;
+        }
+        case ExprKind::MemberExpr: {
+            auto* lhs = llvm::dyn_cast<MemberExpr>(&checkedValue);
+            return lhs && memberExprChainsMatch(llvm::cast<MemberExpr>(expr), *lhs) == true;
+        }
+        default:
+            return false;
+    }
+}
+
 bool Typechecker::isGuaranteedNonNull(const Expr& expr) const {
     if (expr.isNullLiteralExpr()) return false;
 
-    if (currentControlStmts.empty()) {
-        auto stmts = currentFunction->getBody().take_while([&](Stmt* s) { return s != *currentStmt; });
+    if (functionContext->controlStmts.empty()) {
+        return llvm::any_of(functionContext->nonNullValues, [&](const Expr* value) { return isSameNullableValue(*value, expr); });
+    }
 
-        for (auto* stmt : llvm::reverse(stmts)) {
-            if (auto* ifStmt = llvm::dyn_cast<IfStmt>(stmt)) {
-                if (isEarlyExitNullCheck(expr, *ifStmt)) return true;
-            } else {
-                if (auto result = maySetToNullBeforeEvaluating(expr, *stmt); result && *result) return !*result;
-            }
-        }
-    } else {
-        for (auto* currentControlStmt : llvm::reverse(currentControlStmts)) {
-            if (isGuaranteedNonNull(expr, *currentControlStmt)) return true;
-        }
+    for (auto* currentControlStmt : llvm::reverse(functionContext->controlStmts)) {
+        if (isGuaranteedNonNull(expr, *currentControlStmt)) return true;
     }
 
     return false;
@@ -82,23 +99,10 @@ struct NullCheck {
     const Expr* nullableValue = nullptr;
     Token::Kind op = Token::None;
 
-    bool isNullCheckFor(const Expr& expr) {
-        if (!nullableValue) return false;
+    bool isNullCheckFor(const Expr& expr) { return nullableValue && isSameNullableValue(*nullableValue, expr); }
 
-        switch (expr.getKind()) {
-            case ExprKind::VarExpr: {
-                auto* decl = llvm::cast<VarExpr>(expr).getDecl();
-                auto* lhs = llvm::dyn_cast<VarExpr>(nullableValue);
-                return decl && lhs && lhs->getDecl() == decl;
-            }
-            case ExprKind::MemberExpr: {
-                auto* lhs = llvm::dyn_cast<MemberExpr>(nullableValue);
-                return lhs && memberExprChainsMatch(llvm::cast<MemberExpr>(expr), *lhs) == true;
-            }
-            default:
-                return false;
-        }
-    }
+    /// Returns true if the checked value is a variable or member access, the only kinds of values that are tracked.
+    bool isTrackable() const { return nullableValue && (nullableValue->isVarExpr() || nullableValue->isMemberExpr()); }
 };
 } // namespace
 
@@ -128,32 +132,81 @@ static NullCheck analyzeNullCheck(const Expr& condition) {
 }
 
 bool Typechecker::isGuaranteedNonNull(const Expr& expr, const Stmt& currentControlStmt) const {
-    if (!currentControlStmt.isIfStmt() && !currentControlStmt.isWhileStmt() && !currentControlStmt.isForStmt()) return false;
-    auto& condition = getIfOrWhileCondition(currentControlStmt);
+    auto it = functionContext->nullCheckedStmts.find(&currentControlStmt);
+    if (it == functionContext->nullCheckedStmts.end()) return false;
+
+    auto& nullCheckedStmts = it->second;
+    if (!isSameNullableValue(*nullCheckedStmts.checkedValue, expr)) return false;
+    if (nullCheckedStmts.maySetToNull) return !*nullCheckedStmts.maySetToNull;
+
+    // The statements analyzed so far didn't decide it, so continue from the statement containing the expression.
+    for (auto* stmt : nullCheckedStmts.stmts.drop_front(nullCheckedStmts.analyzedStmtCount)) {
+        if (auto result = maySetToNullBeforeEvaluating(expr, *stmt)) return !*result;
+    }
+
+    return false;
+}
+
+void Typechecker::analyzeTopLevelStmtNullChecks(const Stmt& stmt) {
+    auto& nonNullValues = functionContext->nonNullValues;
+
+    if (auto* ifStmt = llvm::dyn_cast<IfStmt>(&stmt)) {
+        if (!ifStmt->getCondition().hasType()) return;
+        NullCheck nullCheck = analyzeNullCheck(ifStmt->getCondition());
+
+        if (nullCheck.isTrackable() && isEarlyExitNullCheck(*nullCheck.nullableValue, *ifStmt)) {
+            nonNullValues.push_back(nullCheck.nullableValue);
+        }
+        return;
+    }
+
+    llvm::erase_if(nonNullValues, [&](const Expr* value) {
+        auto result = maySetToNullBeforeEvaluating(*value, stmt);
+        return result && *result;
+    });
+}
+
+void Typechecker::beginNullCheckedStmts(const Stmt& controlStmt) {
+    if (controlStmt.isForStmt() && !llvm::cast<ForStmt>(controlStmt).getCondition()) return;
+
+    auto& condition = getIfOrWhileCondition(controlStmt);
+    if (!condition.hasType()) return;
     NullCheck nullCheck = analyzeNullCheck(condition);
-    if (!nullCheck.isNullCheckFor(expr)) return false;
+    if (!nullCheck.isTrackable()) return;
 
     llvm::ArrayRef<Stmt*> stmts;
     switch (nullCheck.op) {
         case Token::NotEqual:
-            stmts = getIfOrWhileThenBody(currentControlStmt);
+            stmts = getIfOrWhileThenBody(controlStmt);
             break;
         case Token::Equal:
-            if (auto* ifStmt = llvm::dyn_cast<IfStmt>(&currentControlStmt)) {
+            if (auto* ifStmt = llvm::dyn_cast<IfStmt>(&controlStmt)) {
                 stmts = ifStmt->getElseBody();
             } else {
-                return false;
+                return;
             }
             break;
         default:
-            return false;
+            return;
     }
 
-    for (auto& stmt : stmts) {
-        if (auto result = maySetToNullBeforeEvaluating(expr, *stmt)) return !*result;
-    }
+    functionContext->nullCheckedStmts[&controlStmt] = {nullCheck.nullableValue, stmts};
+}
 
-    return false;
+void Typechecker::analyzeNullCheckedStmt(const Stmt& controlStmt, const Stmt& stmt) {
+    auto it = functionContext->nullCheckedStmts.find(&controlStmt);
+    if (it == functionContext->nullCheckedStmts.end()) return;
+
+    auto& nullCheckedStmts = it->second;
+    if (nullCheckedStmts.maySetToNull || nullCheckedStmts.analyzedStmtCount == nullCheckedStmts.stmts.size()) return;
+    if (nullCheckedStmts.stmts[nullCheckedStmts.analyzedStmtCount] != &stmt) return;
+
+    nullCheckedStmts.analyzedStmtCount++;
+    nullCheckedStmts.maySetToNull = maySetToNullBeforeEvaluating(*nullCheckedStmts.checkedValue, stmt);
+}
+
+void Typechecker::endNullCheckedStmts(const Stmt& controlStmt) {
+    functionContext->nullCheckedStmts.erase(&controlStmt);
 }
 
 bool Typechecker::isEarlyExitNullCheck(const Expr& expr, const IfStmt& stmt) {
@@ -287,9 +340,22 @@ TypeDecl* Typechecker::getTypeDecl(const BasicType& type) {
     decls = findDecls(type.getName());
     if (decls.empty()) return nullptr;
     ASSERT(decls.size() == 1);
-    auto instantiation = llvm::cast<TypeTemplate>(decls[0])->instantiate(type.getGenericArgs());
-    getCurrentModule()->addToSymbolTable(*instantiation);
-    declsToTypecheck.push_back(instantiation);
+    return instantiateTypeTemplate(*llvm::cast<TypeTemplate>(decls[0]), type.getGenericArgs());
+}
+
+/// Returns the instantiation of the given type template with the given generic arguments, and adds it to the symbol
+/// table of the current module if it's not there yet. Instantiations are shared between modules, so each one is only
+/// created and typechecked once, even if it's requested by multiple modules.
+TypeDecl* Typechecker::instantiateTypeTemplate(TypeTemplate& typeTemplate, llvm::ArrayRef<Type> genericArgs) {
+    bool isNewInstantiation = typeTemplate.getInstantiation(genericArgs) == nullptr;
+    auto* instantiation = typeTemplate.instantiate(genericArgs);
+    auto* module = getCurrentModule();
+
+    if (!llvm::is_contained(module->getSymbolTable().find(instantiation->getQualifiedName()), instantiation)) {
+        module->addToSymbolTable(*instantiation);
+    }
+
+    if (isNewInstantiation) declsToTypecheck.push_back(instantiation);
     return instantiation;
 }
 
@@ -330,7 +396,9 @@ llvm::ErrorOr<const Module&> Typechecker::importDeltaModule(SourceFile* importer
         return *it->second;
     }
 
+    llvm::TimeTraceScope timeScope("Import module", moduleName);
     auto module = new Module(moduleName);
+    module->setPrecompiled(moduleName == "std" && options.usePrecompiledStdlib);
     std::error_code error;
 
     if (manifest) {
@@ -361,7 +429,7 @@ done:
 void Typechecker::postProcess() {
     llvm::SaveAndRestore setPostProcessing(isPostProcessing, true);
 
-    while (!declsToTypecheck.empty()) {
+    while (!declsToTypecheck.empty() || !referencedUncheckedFunctions.empty()) {
         auto currentDeclsToTypecheck = std::move(declsToTypecheck);
 
         for (auto* decl : currentDeclsToTypecheck) {
@@ -369,9 +437,14 @@ void Typechecker::postProcess() {
                 case DeclKind::FunctionDecl:
                 case DeclKind::MethodDecl:
                 case DeclKind::ConstructorDecl:
-                case DeclKind::DestructorDecl:
-                    typecheckFunctionDecl(*llvm::cast<FunctionDecl>(decl));
+                case DeclKind::DestructorDecl: {
+                    auto* functionDecl = llvm::cast<FunctionDecl>(decl);
+                    // Deferred bodies are typechecked below, in the context of the source file that declares them.
+                    bool isDeferred = getUncheckedFunctionBodies().count(functionDecl) != 0 ||
+                                      llvm::any_of(referencedUncheckedFunctions, [&](auto& entry) { return entry.first == functionDecl; });
+                    if (!isDeferred) typecheckFunctionDecl(*functionDecl);
                     break;
+                }
                 case DeclKind::FunctionTemplate:
                     typecheckFunctionTemplate(*llvm::cast<FunctionTemplate>(decl));
                     break;
@@ -382,6 +455,80 @@ void Typechecker::postProcess() {
                     llvm_unreachable("invalid deferred decl");
             }
         }
+
+        auto currentReferencedFunctions = std::move(referencedUncheckedFunctions);
+
+        for (auto [functionDecl, sourceFile] : currentReferencedFunctions) {
+            llvm::SaveAndRestore setCurrentModule(currentModule, functionDecl->getModule());
+            llvm::SaveAndRestore setCurrentSourceFile(currentSourceFile, sourceFile);
+            typecheckFunctionDecl(*functionDecl);
+        }
+    }
+}
+
+/// Leaves the body of the given function unchecked until the function is referenced, if possible. This is done for
+/// functions in imported modules, except for ones that the code generator may call without them being referenced in
+/// the source code, e.g. destructors and interface methods. Returns true if the body was deferred.
+bool Typechecker::deferBodyTypechecking(FunctionDecl& decl) {
+    if (options.typecheckAllFunctionBodies || decl.isReferenced() || decl.getModule()->getName() == "main") return false;
+    if (decl.isLambda() || decl.isDestructorDecl() || !decl.getGenericArgs().empty()) return false;
+
+    if (auto* typeDecl = decl.getTypeDecl()) {
+        if (typeDecl->isInterface() || !typeDecl->getInterfaces().empty() || !typeDecl->getGenericArgs().empty()) return false;
+        // The string constructors are called for string literals.
+        if (decl.isConstructorDecl() && typeDecl->getName() == "string") return false;
+    }
+
+    // Called when a runtime check fails.
+    if (decl.getName() == "assertFail") return false;
+    // Extern function definitions may be called from outside the package.
+    if (decl.isExtern()) return false;
+
+    checkCanModifySharedState();
+    getUncheckedFunctionBodies().try_emplace(&decl, currentSourceFile);
+    return true;
+}
+
+void Typechecker::markTypechecked(FunctionDecl& decl) {
+    if (isConcurrentWorker) {
+        typecheckedDecls.push_back(&decl);
+        return;
+    }
+
+    decl.setTypechecked(true);
+}
+
+void Typechecker::markReferenced(Decl& decl) {
+    if (isConcurrentWorker) {
+        if (!decl.isReferenced()) referencedDecls.push_back(&decl);
+        return;
+    }
+
+    decl.setReferenced(true);
+
+    if (auto* functionDecl = llvm::dyn_cast<FunctionDecl>(&decl)) {
+        auto& uncheckedFunctionBodies = getUncheckedFunctionBodies();
+        auto it = uncheckedFunctionBodies.find(functionDecl);
+        if (it != uncheckedFunctionBodies.end()) {
+            referencedUncheckedFunctions.emplace_back(it->first, it->second);
+            uncheckedFunctionBodies.erase(it);
+        }
+    }
+}
+
+size_t Typechecker::getUncheckedFunctionBodyCount() {
+    return getUncheckedFunctionBodies().size();
+}
+
+bool Typechecker::hasUncheckedFunctionBodies(const Module& module) {
+    return llvm::any_of(getUncheckedFunctionBodies(), [&](auto& entry) { return entry.first->getModule() == &module; });
+}
+
+void Typechecker::forgetUncheckedFunctionBodies(const Module& module) {
+    auto& uncheckedFunctionBodies = getUncheckedFunctionBodies();
+    for (auto it = uncheckedFunctionBodies.begin(), end = uncheckedFunctionBodies.end(); it != end;) {
+        auto current = it++;
+        if (current->first->getModule() == &module) uncheckedFunctionBodies.erase(current);
     }
 }
 
@@ -399,6 +546,7 @@ static void checkUnusedDecls(const Module& module) {
 }
 
 void Typechecker::typecheckModule(Module& module, const PackageManifest* manifest) {
+    llvm::TimeTraceScope timeScope("Typecheck module", module.getName());
     auto stdModule = importDeltaModule(nullptr, nullptr, "std");
     if (!stdModule) {
         ABORT("couldn't import the standard library: " << stdModule.getError().message());
@@ -454,19 +602,23 @@ void Typechecker::typecheckModule(Module& module, const PackageManifest* manifes
         postProcess();
     }
 
-    for (auto& sourceFile : module.getSourceFiles()) {
-        for (auto& decl : sourceFile.getTopLevelDecls()) {
-            currentModule = &module;
-            currentSourceFile = &sourceFile;
+    if (options.typecheckThreadCount > 1 && module.getName() == "main") {
+        typecheckTopLevelDeclsConcurrently(module, manifest);
+    } else {
+        for (auto& sourceFile : module.getSourceFiles()) {
+            for (auto& decl : sourceFile.getTopLevelDecls()) {
+                currentModule = &module;
+                currentSourceFile = &sourceFile;
+
+                if (!decl->isVarDecl()) {
+                    try {
+                        typecheckTopLevelDecl(*decl, manifest);
+                    } catch (const CompileError& error) {
+                        error.print();
+                    }
 
-            if (!decl->isVarDecl()) {
-                try {
-                    typecheckTopLevelDecl(*decl, manifest);
-                } catch (const CompileError& error) {
-                    error.print();
+                    postProcess();
                 }
-
-                postProcess();
             }
         }
     }
@@ -479,41 +631,179 @@ void Typechecker::typecheckModule(Module& module, const PackageManifest* manifes
     currentSourceFile = nullptr;
 }
 
+namespace {
+/// A top-level declaration typechecked by typecheckTopLevelDeclsConcurrently(), and the results of typechecking it.
+struct ConcurrentTopLevelDecl {
+    Decl* decl;
+    SourceFile* sourceFile;
+    /// Whether this is a function whose body is typechecked on a worker thread.
+    bool isConcurrent = false;
+    /// Whether typechecking the function on a worker thread was aborted because it would modify shared state.
+    bool modifiesSharedState = false;
+    DiagnosticBuffer diagnostics;
+    std::vector<Decl*> referencedDecls;
+    std::vector<FunctionDecl*> typecheckedDecls;
+    std::vector<Decl*> declsToTypecheck;
+};
+} // namespace
+
+/// Typechecks the non-variable top-level declarations of the given module, typechecking the top-level functions on a
+/// thread pool after the other declarations. Each function is typechecked by its own Typechecker, while shared state,
+/// e.g. the type and identifier tables, symbol tables, and template instantiations, is read-only. A function whose
+/// typechecking would modify shared state, e.g. by interning a new type or instantiating a template, is typechecked
+/// again serially afterwards. Diagnostics are buffered and printed in the order of the declarations, so the output
+/// doesn't depend on the scheduling of the threads.
+void Typechecker::typecheckTopLevelDeclsConcurrently(Module& module, const PackageManifest* manifest) {
+    std::vector<ConcurrentTopLevelDecl> decls;
+
+    for (auto& sourceFile : module.getSourceFiles()) {
+        for (auto& decl : sourceFile.getTopLevelDecls()) {
+            if (decl->isVarDecl()) continue;
+            ConcurrentTopLevelDecl entry{decl, &sourceFile};
+            entry.isConcurrent = decl->getKind() == DeclKind::FunctionDecl && !llvm::cast<FunctionDecl>(decl)->isExtern();
+            decls.push_back(std::move(entry));
+        }
+    }
+
+    for (auto& entry : decls) {
+        if (entry.isConcurrent) continue;
+        DiagnosticBufferScope diagnosticScope(entry.diagnostics);
+        currentModule = &module;
+        currentSourceFile = entry.sourceFile;
+
+        try {
+            typecheckTopLevelDecl(*entry.decl, manifest);
+        } catch (const CompileError& error) {
+            error.print();
+        }
+
+        postProcess();
+    }
+
+    {
+        llvm::ThreadPool threadPool(options.typecheckThreadCount);
+
+        for (auto& entry : decls) {
+            if (!entry.isConcurrent) continue;
+
+            threadPool.async([this, &module, &context = CompilationContext::getCurrent(), entry = &entry] {
+                CompilationContextScope contextScope(context);
+                Typechecker typechecker(options);
+                typechecker.currentModule = &module;
+                typechecker.currentSourceFile = entry->sourceFile;
+                typechecker.isConcurrentWorker = true;
+                DiagnosticBuffer diagnostics;
+
+                try {
+                    DiagnosticBufferScope diagnosticScope(diagnostics);
+                    ReadOnlySharedStateScope readOnlyScope;
+
+                    try {
+                        typechecker.typecheckFunctionDecl(llvm::cast<FunctionDecl>(*entry->decl));
+                    } catch (const CompileError& error) {
+                        error.print();
+                    }
+                } catch (const SharedStateModification&) {
+                    entry->modifiesSharedState = true;
+                    return;
+                }
+
+                entry->diagnostics = std::move(diagnostics);
+                entry->referencedDecls = std::move(typechecker.referencedDecls);
+                entry->typecheckedDecls = std::move(typechecker.typecheckedDecls);
+                entry->declsToTypecheck = std::move(typechecker.declsToTypecheck);
+            });
+        }
+
+        threadPool.wait();
+    }
+
+    for (auto& entry : decls) {
+        if (!entry.isConcurrent) continue;
+        DiagnosticBufferScope diagnosticScope(entry.diagnostics);
+        currentModule = &module;
+        currentSourceFile = entry.sourceFile;
+
+        if (entry.modifiesSharedState) {
+            addStatistic("typecheck", "serially-retypechecked-functions");
+
+            try {
+                typecheckTopLevelDecl(*entry.decl, manifest);
+            } catch (const CompileError& error) {
+                error.print();
+            }
+        } else {
+            addStatistic("typecheck", "concurrently-typechecked-functions");
+
+            for (auto* decl : entry.typecheckedDecls) {
+                decl->setTypechecked(true);
+            }
+            for (auto* decl : entry.referencedDecls) {
+                markReferenced(*decl);
+            }
+            declsToTypecheck.insert(declsToTypecheck.end(), entry.declsToTypecheck.begin(), entry.declsToTypecheck.end());
+        }
+
+        postProcess();
+    }
+
+    for (auto& entry : decls) {
+        entry.diagnostics.flush();
+    }
+}
+
 bool Typechecker::isWarningEnabled(llvm::StringRef warning) const {
     return !llvm::is_contained(options.disabledWarnings, warning);
 }
 
-static llvm::SmallVector<Decl*, 1> findDeclsInModules(llvm::StringRef name, llvm::ArrayRef<Module*> modules) {
+/// Searches only the given modules that declare the name according to the declaration index, instead of probing the
+/// symbol table of each given module. The results are in the order of the given modules.
+static llvm::SmallVector<Decl*, 1> findDeclsInModules(Identifier name, llvm::ArrayRef<Module*> modules) {
     llvm::SmallVector<Decl*, 1> decls;
+    if (!name) return decls;
 
-    for (auto& module : modules) {
+    auto modulesDeclaringName = Module::getModulesDeclaring(name);
+    if (modulesDeclaringName.empty()) return decls;
+
+    // Walking the given modules in order keeps the results in that order without sorting, and removing each found
+    // module from the set stops the walk as soon as all declaring modules have been seen.
+    llvm::SmallPtrSet<Module*, 4> declaringModules(modulesDeclaringName.begin(), modulesDeclaringName.end());
+
+    for (auto* module : modules) {
+        if (!declaringModules.erase(module)) continue;
         llvm::ArrayRef<Decl*> matches = module->getSymbolTable().find(name);
         decls.append(matches.begin(), matches.end());
+        if (declaringModules.empty()) break;
     }
 
     return decls;
 }
 
-static Decl* findDeclInModules(llvm::StringRef name, SourceLocation location, llvm::ArrayRef<Module*> modules) {
-    auto decls = findDeclsInModules(name, modules);
-
+static Decl* findSingleDecl(llvm::ArrayRef<Decl*> decls, Identifier name, SourceLocation location) {
     if (decls.empty()) {
         return nullptr;
     } else {
-        if (decls.size() > 1) ERROR(location, "ambiguous reference to '" << name << "'");
+        if (decls.size() > 1) ERROR(location, "ambiguous reference to '" << name.str() << "'");
         return decls[0];
     }
 }
 
+static Decl* findDeclInModules(Identifier name, SourceLocation location, llvm::ArrayRef<Module*> modules) {
+    return findSingleDecl(findDeclsInModules(name, modules), name, location);
+}
+
 Decl* Typechecker::findDecl(llvm::StringRef name, SourceLocation location) const {
     ASSERT(!name.empty());
+    // Looked up in the identifier table once, so that the symbol tables below are searched by pointer.
+    Identifier identifier = Identifier::find(name);
 
-    if (Decl* match = findDeclInModules(name, location, currentModule)) {
+    // The current module is searched directly, because the declaration index doesn't include its local scopes.
+    if (Decl* match = findSingleDecl(currentModule->getSymbolTable().find(identifier), identifier, location)) {
         return match;
     }
 
-    if (currentFunction) {
-        if (auto* typeDecl = currentFunction->getTypeDecl()) {
+    if (functionContext->function) {
+        if (auto* typeDecl = functionContext->function->getTypeDecl()) {
             for (auto& field : typeDecl->getFields()) {
                 if (field.getName() == name) {
                     return &field;
@@ -522,16 +812,16 @@ Decl* Typechecker::findDecl(llvm::StringRef name, SourceLocation location) const
         }
     }
 
-    if (Decl* match = findDeclInModules(name, location, Module::getStdlibModule())) {
+    if (Decl* match = findDeclInModules(identifier, location, Module::getStdlibModule())) {
         return match;
     }
 
     if (currentSourceFile) {
-        if (Decl* match = findDeclInModules(name, location, currentSourceFile->getImportedModules())) {
+        if (Decl* match = findDeclInModules(identifier, location, currentSourceFile->getImportedModules())) {
             return match;
         }
     } else {
-        if (Decl* match = findDeclInModules(name, location, Module::getAllImportedModules())) {
+        if (Decl* match = findDeclInModules(identifier, location, Module::getAllImportedModules())) {
             return match;
         }
     }
@@ -551,8 +841,8 @@ static void append(std::vector<Decl*>& target, llvm::ArrayRef<Decl*> source) {
 std::vector<Decl*> Typechecker::findDecls(llvm::StringRef name, TypeDecl* receiverTypeDecl, bool inAllImportedModules) const {
     std::vector<Decl*> decls;
 
-    if (!receiverTypeDecl && currentFunction) {
-        receiverTypeDecl = currentFunction->getTypeDecl();
+    if (!receiverTypeDecl && functionContext->function) {
+        receiverTypeDecl = functionContext->function->getTypeDecl();
     }
 
     if (receiverTypeDecl) {
@@ -576,16 +866,19 @@ std::vector<Decl*> Typechecker::findDecls(llvm::StringRef name, TypeDecl* receiv
         }
     }
 
+    Identifier identifier = Identifier::find(name);
+
+    // The current module is searched directly, because the declaration index doesn't include its local scopes.
+    append(decls, currentModule->getSymbolTable().find(identifier));
+
     if (currentModule->getName() != "std") {
-        append(decls, findDeclsInModules(name, currentModule));
+        append(decls, findDeclsInModules(identifier, Module::getStdlibModule()));
     }
 
-    append(decls, findDeclsInModules(name, Module::getStdlibModule()));
-
     if (currentSourceFile && !inAllImportedModules) {
-        append(decls, findDeclsInModules(name, currentSourceFile->getImportedModules()));
+        append(decls, findDeclsInModules(identifier, currentSourceFile->getImportedModules()));
     } else {
-        append(decls, findDeclsInModules(name, Module::getAllImportedModules()));
+        append(decls, findDeclsInModules(identifier, Module::getAllImportedModules()));
     }
 
     return decls;
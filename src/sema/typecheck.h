@@ -2,8 +2,11 @@
 
 #include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #pragma warning(push, 0)
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/StringMap.h>
 #include <llvm/Support/ErrorOr.h>
@@ -39,12 +42,59 @@ struct ArgumentValidation {
     ArgumentValidation(Error error, int index) : error(error), index(index) {}
 };
 
+/// The statements guarded by a null check, e.g. the then-body of 'if (p != null)', and the progress of the null-check
+/// analysis over them. Each statement is analyzed once, after it has been typechecked.
+struct NullCheckedStmts {
+    const Expr* checkedValue;
+    llvm::ArrayRef<Stmt*> stmts;
+    size_t analyzedStmtCount = 0;
+    /// Whether the analyzed statements may set the checked value to null, or empty if they didn't decide it.
+    llvm::Optional<bool> maySetToNull;
+};
+
+/// The state of the function whose body is being typechecked. Each function gets its own context, so that state
+/// such as moved variables and enclosing loops doesn't leak from an enclosing function into a lambda, or vice versa.
+struct FunctionTypecheckContext {
+    FunctionDecl* function = nullptr;
+    std::vector<Stmt*> controlStmts;
+    /// Null unless typechecking a function body.
+    llvm::SmallPtrSet<FieldDecl*, 32>* initializedFields = nullptr;
+    llvm::SmallPtrSet<Decl*, 32> movedDecls;
+    Type returnType;
+    /// Values checked against null by early-exit if-statements among the top-level statements typechecked so far,
+    /// which haven't been set back to null after the check.
+    std::vector<const Expr*> nonNullValues;
+    llvm::DenseMap<const Stmt*, NullCheckedStmts> nullCheckedStmts;
+};
+
+/// The inputs that determine which declaration overload resolution selects for a call, used for memoizing the
+/// selected declaration so that repeated identical calls don't have to be resolved again.
+struct OverloadResolutionKey {
+    std::vector<Decl*> candidates;
+    std::vector<Type> argTypes;
+    std::vector<std::string> argNames;
+    /// Whether each argument is an lvalue, which determines whether it can be implicitly passed by pointer.
+    std::vector<bool> argIsLvalue;
+    std::vector<Type> genericArgs;
+    Type expectedType;
+
+    bool operator==(const OverloadResolutionKey& other) const;
+    struct Hash {
+        size_t operator()(const OverloadResolutionKey& key) const;
+    };
+};
+
 class Typechecker {
 public:
     Typechecker(const CompileOptions& options)
-    : currentModule(nullptr), currentSourceFile(nullptr), currentFunction(nullptr), currentStmt(nullptr), currentInitializedFields(nullptr),
-      isPostProcessing(false), options(options) {}
+    : currentModule(nullptr), currentSourceFile(nullptr), functionContext(&topLevelContext), isPostProcessing(false), options(options) {}
     void typecheckModule(Module& module, const PackageManifest* manifest);
+    /// Returns the number of functions in imported modules whose bodies haven't been typechecked because they
+    /// haven't been referenced.
+    static size_t getUncheckedFunctionBodyCount();
+    static bool hasUncheckedFunctionBodies(const Module& module);
+    /// Forgets the unchecked function bodies of the given module, which is being discarded.
+    static void forgetUncheckedFunctionBodies(const Module& module);
 
 private:
     Module* getCurrentModule() const { return NOTNULL(currentModule); }
@@ -54,6 +104,10 @@ private:
     void typecheckTopLevelDecl(Decl& decl, const PackageManifest* manifest);
     void typecheckParams(llvm::MutableArrayRef<ParamDecl> params, AccessLevel userAccessLevel);
     void typecheckFunctionDecl(FunctionDecl& decl);
+    void typecheckTopLevelDeclsConcurrently(Module& module, const PackageManifest* manifest);
+    bool deferBodyTypechecking(FunctionDecl& decl);
+    void markReferenced(Decl& decl);
+    void markTypechecked(FunctionDecl& decl);
     void typecheckFunctionTemplate(FunctionTemplate& decl);
     void typecheckMethodDecl(Decl& decl);
 
@@ -105,6 +159,8 @@ private:
     std::vector<Decl*> findDecls(llvm::StringRef name, TypeDecl* receiverTypeDecl = nullptr, bool inAllImportedModules = false) const;
     std::vector<Decl*> findCalleeCandidates(const CallExpr& expr, llvm::StringRef callee);
     Decl* resolveOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr, llvm::StringRef callee, Type expectedType);
+    Decl* selectOverload(llvm::ArrayRef<Decl*> decls, CallExpr& expr, llvm::StringRef callee, Type expectedType);
+    llvm::Optional<OverloadResolutionKey> getOverloadResolutionKey(llvm::ArrayRef<Decl*> decls, CallExpr& expr, Type expectedType);
     std::vector<Type> inferGenericArgsFromCallArgs(llvm::ArrayRef<GenericParamDecl> genericParams, CallExpr& call,
                                                    llvm::ArrayRef<ParamDecl> params, bool returnOnError);
     ArgumentValidation getArgumentValidationResult(CallExpr& expr, llvm::ArrayRef<ParamDecl> params, bool isVariadic);
@@ -113,6 +169,7 @@ private:
     void validateArgs(CallExpr& expr, llvm::ArrayRef<ParamDecl> params, bool isVariadic, llvm::StringRef functionName = "",
                       SourceLocation location = SourceLocation());
     TypeDecl* getTypeDecl(const BasicType& type);
+    TypeDecl* instantiateTypeTemplate(TypeTemplate& typeTemplate, llvm::ArrayRef<Type> genericArgs);
     EnumCase* getEnumCase(const Expr& expr);
     void checkReturnPointerToLocal(const ReturnStmt& stmt) const;
     static void checkHasAccess(const Decl& decl, SourceLocation location, AccessLevel userAccessLevel);
@@ -126,6 +183,13 @@ private:
     bool isGuaranteedNonNull(const Expr& expr) const;
     bool isGuaranteedNonNull(const Expr& expr, const Stmt& currentControlStmt) const;
 
+    /// Forward null-check analysis, updated as the statements of the current function are typechecked, so that
+    /// isGuaranteedNonNull() doesn't have to rescan the preceding statements for each expression.
+    void analyzeTopLevelStmtNullChecks(const Stmt& stmt);
+    void beginNullCheckedStmts(const Stmt& controlStmt);
+    void analyzeNullCheckedStmt(const Stmt& controlStmt, const Stmt& stmt);
+    void endNullCheckedStmts(const Stmt& controlStmt);
+
     /// Returns true if the given if-statement returns when the given variable is null.
     static bool isEarlyExitNullCheck(const Expr& expr, const IfStmt& stmt);
 
@@ -146,14 +210,20 @@ private:
 private:
     Module* currentModule;
     SourceFile* currentSourceFile;
-    FunctionDecl* currentFunction;
-    Stmt** currentStmt; // Double-pointer so it refers to the correct statement after lowering.
-    std::vector<Stmt*> currentControlStmts;
-    llvm::SmallPtrSet<FieldDecl*, 32>* currentInitializedFields;
-    llvm::SmallPtrSet<Decl*, 32> movedDecls;
-    Type functionReturnType;
+    /// Used outside function bodies, e.g. for global variable initializers.
+    FunctionTypecheckContext topLevelContext;
+    FunctionTypecheckContext* functionContext;
     bool isPostProcessing;
+    /// True if this typechecks a function body on a worker thread, see typecheckTopLevelDeclsConcurrently().
+    bool isConcurrentWorker = false;
+    /// The decls referenced by the function body typechecked on a worker thread, to be marked referenced afterwards.
+    std::vector<Decl*> referencedDecls;
+    /// The functions typechecked on a worker thread, to be marked typechecked only if the worker isn't aborted.
+    std::vector<FunctionDecl*> typecheckedDecls;
     std::vector<Decl*> declsToTypecheck;
+    std::unordered_map<OverloadResolutionKey, Decl*, OverloadResolutionKey::Hash> resolvedOverloads;
+    /// Functions whose body typechecking was deferred and that have since been referenced.
+    std::vector<std::pair<FunctionDecl*, SourceFile*>> referencedUncheckedFunctions;
     const CompileOptions& options;
 };
 
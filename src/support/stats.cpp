@@ -0,0 +1,118 @@
+#include "stats.h"
+#include <map>
+#include <mutex>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <unistd.h>
+#endif
+#pragma warning(push, 0)
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#pragma warning(pop)
+
+using namespace delta;
+
+bool delta::collectStatistics = false;
+
+static std::map<std::string, std::map<std::string, uint64_t>> statistics;
+// The backends of the targets built by 'delta build' may run concurrently.
+static std::mutex statisticsMutex;
+
+void delta::addStatistic(llvm::StringRef group, llvm::StringRef name, uint64_t amount) {
+    if (!collectStatistics) return;
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    statistics[group.str()][name.str()] += amount;
+}
+
+static uint64_t getPeakResidentSetSize() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static uint64_t getCurrentResidentSetSize() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) return 0;
+    return info.resident_size;
+#elif defined(__linux__)
+    // The second field is the number of resident pages.
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size, residentPages;
+    if (!(statm >> size >> residentPages)) return 0;
+    return residentPages * uint64_t(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+static void addProcessStatistics() {
+    addStatistic("process", "peak-rss-bytes", getPeakResidentSetSize());
+}
+
+PhaseStatistics::PhaseStatistics(llvm::StringRef phase) : phase(phase) {
+    if (!collectStatistics) return;
+    start = std::chrono::steady_clock::now();
+    startResidentSetSize = getCurrentResidentSetSize();
+}
+
+PhaseStatistics::~PhaseStatistics() {
+    if (!collectStatistics) return;
+    auto wallTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    addStatistic("phases.wall-time-us", phase, uint64_t(wallTime.count()));
+    uint64_t residentSetSize = getCurrentResidentSetSize();
+    addStatistic("phases.rss-growth-bytes", phase, residentSetSize > startResidentSetSize ? residentSetSize - startResidentSetSize : 0);
+}
+
+void delta::printStatistics(llvm::raw_ostream& stream) {
+    addProcessStatistics();
+
+    for (auto& group : statistics) {
+        stream << group.first << ":\n";
+
+        for (auto& counter : group.second) {
+            stream << "  " << counter.first << ": " << counter.second << "\n";
+        }
+    }
+}
+
+void delta::printStatisticsAsJSON(llvm::raw_ostream& stream) {
+    addProcessStatistics();
+    llvm::json::Object root;
+
+    for (auto& group : statistics) {
+        llvm::json::Object counters;
+
+        for (auto& counter : group.second) {
+            counters[counter.first] = int64_t(counter.second);
+        }
+
+        root[group.first] = std::move(counters);
+    }
+
+    stream << llvm::formatv("{0:2}", llvm::json::Value(std::move(root))) << "\n";
+}
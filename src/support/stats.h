@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#pragma warning(push, 0)
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#pragma warning(pop)
+
+namespace delta {
+
+/// Set by -print-stats. Statistics are only collected when this is true, so that counting doesn't slow down
+/// regular compilation.
+extern bool collectStatistics;
+
+/// Adds the given amount to the counter with the given name in the given group, e.g. group "ast.exprs" and name
+/// "CallExpr". Does nothing if statistics are not being collected.
+void addStatistic(llvm::StringRef group, llvm::StringRef name, uint64_t amount = 1);
+void printStatistics(llvm::raw_ostream& stream);
+void printStatisticsAsJSON(llvm::raw_ostream& stream);
+
+/// Adds the wall time from construction to destruction to the "phases.wall-time-us" statistic of the given compiler
+/// phase, and the growth of the current resident set size over the same interval to "phases.rss-growth-bytes". A
+/// phase that frees more memory than it allocates records no growth. A phase that runs multiple times, e.g. once per
+/// module, accumulates the time and growth of each run. Nested phases are included in the enclosing phase.
+class PhaseStatistics {
+public:
+    explicit PhaseStatistics(llvm::StringRef phase);
+    ~PhaseStatistics();
+
+private:
+    llvm::StringRef phase;
+    std::chrono::steady_clock::time_point start;
+    uint64_t startResidentSetSize;
+};
+
+} // namespace delta
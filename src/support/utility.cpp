@@ -49,7 +49,15 @@ void delta::renameFile(llvm::Twine sourcePath, llvm::Twine targetPath) {
     }
 }
 
+static thread_local DiagnosticBuffer* currentDiagnosticBuffer = nullptr;
+static thread_local bool sharedStateIsReadOnly = false;
+
 void delta::printDiagnostic(SourceLocation location, llvm::StringRef type, llvm::raw_ostream::Colors color, llvm::StringRef message) {
+    if (currentDiagnosticBuffer) {
+        currentDiagnosticBuffer->addDiagnostic(location, type, color, message);
+        return;
+    }
+
     if (llvm::outs().has_colors()) {
         llvm::outs().changeColor(llvm::raw_ostream::SAVEDCOLOR, true);
     }
@@ -75,6 +83,52 @@ void delta::printDiagnostic(SourceLocation location, llvm::StringRef type, llvm:
     llvm::outs() << '\n';
 }
 
+DiagnosticBuffer* DiagnosticBuffer::getCurrent() {
+    return currentDiagnosticBuffer;
+}
+
+void DiagnosticBuffer::addDiagnostic(SourceLocation location, llvm::StringRef type, llvm::raw_ostream::Colors color,
+                                     llvm::StringRef message) {
+    diagnostics.push_back({location, type.str(), color, message.str()});
+}
+
+void DiagnosticBuffer::flush() {
+    ASSERT(currentDiagnosticBuffer != this);
+
+    for (auto& diagnostic : diagnostics) {
+        printDiagnostic(diagnostic.location, diagnostic.type, diagnostic.color, diagnostic.message);
+    }
+
+    if (currentDiagnosticBuffer) {
+        currentDiagnosticBuffer->errorCount += errorCount;
+    } else {
+        errors += errorCount;
+    }
+
+    diagnostics.clear();
+    errorCount = 0;
+}
+
+DiagnosticBufferScope::DiagnosticBufferScope(DiagnosticBuffer& buffer) : previousBuffer(currentDiagnosticBuffer) {
+    currentDiagnosticBuffer = &buffer;
+}
+
+DiagnosticBufferScope::~DiagnosticBufferScope() {
+    currentDiagnosticBuffer = previousBuffer;
+}
+
+ReadOnlySharedStateScope::ReadOnlySharedStateScope() : wasReadOnly(sharedStateIsReadOnly) {
+    sharedStateIsReadOnly = true;
+}
+
+ReadOnlySharedStateScope::~ReadOnlySharedStateScope() {
+    sharedStateIsReadOnly = wasReadOnly;
+}
+
+void delta::checkCanModifySharedState() {
+    if (sharedStateIsReadOnly) throw SharedStateModification();
+}
+
 CompileError::CompileError() = default;
 
 CompileError::CompileError(SourceLocation location, std::string&& message, std::vector<Note>&& notes)
@@ -117,7 +171,12 @@ void delta::abort(StringFormatter& message) {
 }
 
 void delta::reportError(SourceLocation location, StringFormatter& message, llvm::ArrayRef<Note> notes) {
-    errors++;
+    if (auto* buffer = DiagnosticBuffer::getCurrent()) {
+        buffer->addError();
+    } else {
+        errors++;
+    }
+
     printDiagnostic(location, "error", llvm::raw_ostream::RED, message.str());
 
     for (auto& note : notes) {
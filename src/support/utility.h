@@ -8,6 +8,7 @@
 #pragma warning(push, 0)
 #include <llvm/ADT/ArrayRef.h>
 #include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/raw_ostream.h>
 #pragma warning(pop)
@@ -71,6 +72,59 @@ struct CompileError : std::exception {
     std::vector<Note> notes;
 };
 
+/// Collects diagnostics instead of printing them while a DiagnosticBufferScope for it is alive, so that diagnostics
+/// reported concurrently by multiple threads can be printed in a deterministic order.
+class DiagnosticBuffer {
+public:
+    /// Returns the buffer collecting the diagnostics of the current thread, or null if they're printed immediately.
+    static DiagnosticBuffer* getCurrent();
+    void addDiagnostic(SourceLocation location, llvm::StringRef type, llvm::raw_ostream::Colors color, llvm::StringRef message);
+    void addError() { errorCount++; }
+    int getErrorCount() const { return errorCount; }
+    /// Prints the collected diagnostics and counts the collected errors, or moves them to the buffer of the current
+    /// thread if it has one.
+    void flush();
+
+private:
+    struct Diagnostic {
+        SourceLocation location;
+        std::string type;
+        llvm::raw_ostream::Colors color;
+        std::string message;
+    };
+
+    std::vector<Diagnostic> diagnostics;
+    int errorCount = 0;
+};
+
+/// Makes the given buffer collect the diagnostics reported on the current thread until destroyed.
+class DiagnosticBufferScope {
+public:
+    explicit DiagnosticBufferScope(DiagnosticBuffer& buffer);
+    ~DiagnosticBufferScope();
+
+private:
+    DiagnosticBuffer* previousBuffer;
+};
+
+/// Thrown by checkCanModifySharedState() when the current thread is only allowed to read shared state.
+struct SharedStateModification {};
+
+/// Makes the current thread read-only with respect to state shared between threads, such as the identifier and type
+/// tables, the global symbol tables, and template instantiations, until destroyed. Code modifying such state calls
+/// checkCanModifySharedState() first, so that the modification is aborted instead of racing with other threads.
+class ReadOnlySharedStateScope {
+public:
+    ReadOnlySharedStateScope();
+    ~ReadOnlySharedStateScope();
+
+private:
+    bool wasReadOnly;
+};
+
+/// Throws SharedStateModification if the current thread is in a ReadOnlySharedStateScope.
+void checkCanModifySharedState();
+
 template<typename T>
 void printColored(const T& text, llvm::raw_ostream::Colors color) {
     if (llvm::outs().has_colors()) llvm::outs().changeColor(color, true);